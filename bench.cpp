@@ -0,0 +1,304 @@
+// Microbenchmarks for the gameplay hot paths. Builds main.cpp without its
+// main() so the same code the game runs is measured, with no window.
+// Output is one JSON object per line on stdout (or the file given as the
+// first argument) so results can be diffed between versions.
+#define GAME1_NO_MAIN
+#define GAME1_TRACK_ALLOCATIONS
+#include "main.cpp"
+
+#include <chrono>
+#include <cstdio>
+
+const unsigned BENCH_SEED = 12345;
+const double MIN_BENCH_SECONDS = 0.2;
+
+FILE* benchOut = stdout;
+
+struct BenchParam {
+    const char* name;
+    long long value;
+};
+
+// Reseeds and runs setup before each batch of op calls, doubling the batch
+// until it takes at least MIN_BENCH_SECONDS, and reports that batch.
+template <typename Setup, typename Op>
+void runBenchmark(const char* name, const vector<BenchParam>& params, Setup setup, Op op) {
+    using clock = chrono::steady_clock;
+
+    long long iterations = 1;
+    double seconds = 0;
+    size_t allocations = 0;
+    while (true) {
+        srand(BENCH_SEED);
+        setup();
+        size_t allocsBefore = allocationCount;
+        auto start = clock::now();
+        for (long long i = 0; i < iterations; i++) {
+            op();
+        }
+        seconds = chrono::duration<double>(clock::now() - start).count();
+        allocations = allocationCount - allocsBefore;
+        if (seconds >= MIN_BENCH_SECONDS || iterations >= (1LL << 30)) break;
+        iterations *= 2;
+    }
+
+    fprintf(benchOut, "{\"name\":\"%s\",\"params\":{", name);
+    for (size_t i = 0; i < params.size(); i++) {
+        fprintf(benchOut, "%s\"%s\":%lld", i ? "," : "", params[i].name, params[i].value);
+    }
+    fprintf(benchOut, "},\"seed\":%u,\"iterations\":%lld,\"ns_per_op\":%.1f,\"allocs_per_op\":%.3f}\n",
+            BENCH_SEED, iterations, seconds * 1e9 / iterations, double(allocations) / iterations);
+    fflush(benchOut);
+}
+
+void placeRandom(vector<GameObject>& objects, int count, int w, int h) {
+    objects.clear();
+    for (int i = 0; i < count; i++) {
+        objects.push_back({ rand() % (SCREEN_WIDTH - w), rand() % (SCREEN_HEIGHT - h), w, h, true });
+    }
+}
+
+void benchCollision(int bulletCount, int enemyCount) {
+    vector<GameObject> bulletSetup, enemySetup;
+    runBenchmark("survival_collision", { { "bullets", bulletCount }, { "enemies", enemyCount } },
+        [&] {
+            placeRandom(bulletSetup, bulletCount, BULLET_WIDTH, BULLET_HEIGHT);
+            placeRandom(enemySetup, enemyCount, ENEMY_WIDTH, ENEMY_HEIGHT);
+            bullets.reserve(bulletCount);
+            enemies.reserve(enemyCount);
+        },
+        [&] {
+            bullets.assign(bulletSetup.begin(), bulletSetup.end());
+            enemies.assign(enemySetup.begin(), enemySetup.end());
+            resetEventBus(gameEvents);
+            collideBulletsWithEnemies();
+        });
+}
+
+void benchSpiral(int bulletCount) {
+    Boss boss;
+    vector<GameObject> spiralSetup;
+    Player player = { 0, SCREEN_HEIGHT - PLAYER_HEIGHT };
+    runBenchmark("spiral_update", { { "bullets", bulletCount } },
+        [&] {
+            initBoss(boss);
+            spiralSetup.clear();
+            for (int i = 0; i < bulletCount; i++) {
+                float angle = i * 6.2831853f / bulletCount;
+                int distance = 10 + rand() % 200;
+                spiralSetup.push_back({ int(boss.x + BOSS_WIDTH / 2 + distance * cos(angle)),
+                                        int(boss.y + BOSS_HEIGHT + distance * sin(angle)), 20, 20, true });
+            }
+            boss.spiralBullets.reserve(bulletCount);
+        },
+        [&] {
+            boss.spiralBullets.assign(spiralSetup.begin(), spiralSetup.end());
+            updateSpiralBullets(boss, player);
+        });
+}
+
+void benchUpdateBoss(int frames) {
+    Boss boss;
+    Player player;
+    int enemyShootCounter = 0;
+    runBenchmark("boss_update", { { "frames", frames } },
+        [&] {},
+        [&] {
+            initBoss(boss);
+            resetEventBus(gameEvents);
+            boss.lasers.clear();
+            boss.spiralBullets.clear();
+            boss.minions.clear();
+            enemyBullets.clear();
+            player = { SCREEN_WIDTH / 2 - PLAYER_WIDTH / 2, SCREEN_HEIGHT - PLAYER_HEIGHT - 10 };
+            for (int f = 0; f < frames; f++) {
+                updateBoss(boss, player, enemyShootCounter);
+            }
+        });
+}
+
+void benchHoming(int seekerCount) {
+    HomingProjectiles seekers;
+    initHomingProjectiles(seekers);
+    runBenchmark("homing_steer", { { "seekers", seekerCount } },
+        [&] {
+            seekers.count = 0;
+            for (int i = 0; i < seekerCount; i++) {
+                launchHoming(seekers, float(rand() % SCREEN_WIDTH), float(rand() % SCREEN_HEIGHT),
+                             (rand() % 628) * 0.01f, 2.0f, 6.0f, 0.1f, 0.04f, MISSILE_DURATION);
+            }
+        },
+        [&] { steerHoming(seekers, SCREEN_WIDTH / 2, SCREEN_HEIGHT - 100); });
+}
+
+void benchWaves(int waveCount) {
+    runBenchmark("spawn_enemy_wave", { { "waves", waveCount } },
+        [&] {},
+        [&] {
+            enemies.clear();
+            enemyWaveCount = 0;
+            for (int i = 0; i < waveCount; i++) {
+                spawnEnemyWave();
+            }
+        });
+}
+
+// Fills the pool to exactly particleCount with lives long enough that none
+// die during a batch, so only the integrate/compact pass is timed. Drag
+// takes vx into denormals after ~2000 updates, which live particles never
+// reach in the game, so they are flushed to zero for the run.
+void benchParticles(int particleCount) {
+#ifdef __SSE2__
+    unsigned int flushMode = _MM_GET_FLUSH_ZERO_MODE();
+    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+#endif
+    runBenchmark("particles_update", { { "particles", particleCount } },
+        [&] {
+            particles.count = 0;
+            while (particles.count < particleCount) {
+                emitExplosion(particles, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 48, 4.0f, SDL_Color{ 255, 200, 80, 255 });
+            }
+            particles.count = particleCount;
+            for (int i = 0; i < particles.count; i++) {
+                particles.life[i] = 1e9f;
+            }
+        },
+        [&] { updateParticles(particles); });
+#ifdef __SSE2__
+    _MM_SET_FLUSH_ZERO_MODE(flushMode);
+#endif
+}
+
+void benchRenderQueue(SDL_Renderer* renderer, int spriteCount) {
+    SDL_Texture* textures[4] = {};
+    for (int i = 0; i < 4; i++) {
+        textures[i] = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, 32, 32);
+    }
+    vector<SDL_Rect> rects;
+    runBenchmark("render_queue", { { "sprites", spriteCount } },
+        [&] {
+            rects.clear();
+            for (int i = 0; i < spriteCount; i++) {
+                rects.push_back({ rand() % (SCREEN_WIDTH + 200) - 100, rand() % (SCREEN_HEIGHT + 400) - 300, 40, 40 });
+            }
+        },
+        [&] {
+            for (int i = 0; i < spriteCount; i++) {
+                submitDraw(renderQueue, i % 3, textures[i % 4], rects[i]);
+            }
+            flushRenderQueue(renderer, renderQueue);
+        });
+    for (int i = 0; i < 4; i++) {
+        SDL_DestroyTexture(textures[i]);
+    }
+}
+
+// A gameplay-like frame (full-screen background plus sprites) through the
+// dynamic resolution path. 100% draws straight to the window; run this on
+// the software renderer to check that lower scales are actually cheaper.
+void benchScaledRender(SDL_Renderer* renderer, ResolutionScaler& scaler, int scalePercent) {
+    SDL_Texture* background = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, SCREEN_WIDTH, SCREEN_HEIGHT);
+    SDL_Texture* sprite = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, ENEMY_WIDTH, ENEMY_HEIGHT);
+    SDL_SetTextureBlendMode(sprite, SDL_BLENDMODE_BLEND);
+    vector<SDL_Rect> rects;
+    runBenchmark("scaled_render", { { "scale_percent", scalePercent } },
+        [&] {
+            scaler.scale = scalePercent / 100.0f;
+            rects.clear();
+            for (int i = 0; i < 64; i++) {
+                rects.push_back({ rand() % (SCREEN_WIDTH - ENEMY_WIDTH), rand() % (SCREEN_HEIGHT - ENEMY_HEIGHT), ENEMY_WIDTH, ENEMY_HEIGHT });
+            }
+        },
+        [&] {
+            beginScaledRender(renderer, scaler);
+            SDL_Rect screenRect = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+            SDL_RenderCopy(renderer, background, NULL, &screenRect);
+            for (const auto& rect : rects) {
+                submitDraw(renderQueue, LAYER_ENEMIES, sprite, rect);
+            }
+            flushRenderQueue(renderer, renderQueue);
+            endScaledRender(renderer, scaler);
+        });
+    SDL_DestroyTexture(sprite);
+    SDL_DestroyTexture(background);
+}
+
+void benchRenderText(SDL_Renderer* renderer, const GlyphAtlas& atlas) {
+    int score = 123450;
+    runBenchmark("render_text", { { "score", score } },
+        [&] {},
+        [&] {
+            frameArena.used = 0;
+            renderText(renderer, atlas, arenaFormat(frameArena, "Score: %d", score), 950, 10);
+        });
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        benchOut = fopen(argv[1], "w");
+        if (!benchOut) {
+            cerr << "Failed to open " << argv[1] << endl;
+            return -1;
+        }
+    }
+
+    installAllocationHooks();
+    SDL_Init(0);
+    IMG_Init(IMG_INIT_PNG);
+    TTF_Init();
+    TextureManager textures;
+    loadCollisionMasks(textures);
+    initParticles(particles);
+    initFrameArena(frameArena, FRAME_ARENA_SIZE);
+
+    for (int b : { 16, 64, 256 }) {
+        for (int e : { 16, 64, 256 }) {
+            benchCollision(b, e);
+        }
+    }
+    for (int k : { 16, 256, 4096 }) {
+        benchSpiral(k);
+    }
+    benchUpdateBoss(600);
+    for (int k : { 64, 1024, MAX_HOMING_PROJECTILES }) {
+        benchHoming(k);
+    }
+    benchWaves(10000);
+    for (int p : { 1000, 10000, MAX_PARTICLES }) {
+        benchParticles(p);
+    }
+
+    TTF_Font* font = TTF_OpenFont("PixelFont.ttf", 25);
+    SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer* renderer = target ? SDL_CreateSoftwareRenderer(target) : NULL;
+    if (renderer) {
+        initRenderQueue(renderQueue);
+        for (int n : { 64, 1024 }) {
+            benchRenderQueue(renderer, n);
+        }
+        ResolutionScaler scaler;
+        if (initResolutionScaler(renderer, scaler)) {
+            for (int scale : { 100, 90, 70, 50 }) {
+                benchScaledRender(renderer, scaler, scale);
+            }
+            SDL_DestroyTexture(scaler.target);
+        }
+    }
+    if (font && renderer) {
+        GlyphAtlas atlas;
+        loadGlyphAtlas(renderer, font, atlas);
+        benchRenderText(renderer, atlas);
+        destroyGlyphAtlas(atlas);
+    } else {
+        cerr << "Skipping render_text: " << SDL_GetError() << endl;
+    }
+
+    if (renderer) SDL_DestroyRenderer(renderer);
+    if (target) SDL_FreeSurface(target);
+    if (font) TTF_CloseFont(font);
+    if (benchOut != stdout) fclose(benchOut);
+    TTF_Quit();
+    IMG_Quit();
+    SDL_Quit();
+    return 0;
+}
@@ -10,9 +10,68 @@
 #include <string>
 #include <algorithm>
 #include <fstream>
+#include <sstream>
 #include <cmath>
+#include <cstdio>
+#include <cstdarg>
+#include <atomic>
+#include <new>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
+#ifdef GAME1_ASSERT_NO_ALLOCATIONS
+#define GAME1_TRACK_ALLOCATIONS
+#endif
+
+#ifdef GAME1_TRACK_ALLOCATIONS
+// Counts every C++ and SDL heap allocation so steady-state frames can be
+// checked for allocator traffic. Enabled in the Debug target.
+atomic<size_t> allocationCount(0);
+
+void* operator new(size_t size) {
+    allocationCount++;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    allocationCount++;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+// Kept out of line so GCC doesn't pair the inlined free() with operator new
+// and warn about mismatched allocation functions.
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void* p, size_t) noexcept { free(p); }
+
+void* SDLCALL countingMalloc(size_t size) { allocationCount++; return malloc(size); }
+void* SDLCALL countingCalloc(size_t count, size_t size) { allocationCount++; return calloc(count, size); }
+void* SDLCALL countingRealloc(void* p, size_t size) { allocationCount++; return realloc(p, size); }
+void SDLCALL countingFree(void* p) { free(p); }
+
+// Must run before SDL allocates anything.
+void installAllocationHooks() {
+    SDL_SetMemoryFunctions(countingMalloc, countingCalloc, countingRealloc, countingFree);
+}
+#endif
+
 Mix_Chunk* soundHit;
 Mix_Chunk* soundExplode;
 Mix_Chunk* soundShoot;
@@ -24,6 +83,37 @@ enum GameMode {
     EXIT
 };
 
+enum Formation {
+    FORMATION_SINGLE,
+    FORMATION_LINE,
+    FORMATION_ARROW,
+    FORMATION_COUNT
+};
+
+enum EnemyType {
+    ENEMY_BASIC,
+    ENEMY_TYPE_COUNT
+};
+
+enum FirePattern {
+    FIRE_RANDOM,
+    FIRE_NONE,
+    FIRE_PATTERN_COUNT
+};
+
+// Draw order for queued sprites; within a layer commands are grouped by
+// texture.
+enum RenderLayer {
+    LAYER_PLAYER,
+    LAYER_PLAYER_BULLETS,
+    LAYER_BOSS,
+    LAYER_LASERS,
+    LAYER_BOSS_MISSILES,
+    LAYER_SPIRAL_BULLETS,
+    LAYER_ENEMIES,
+    LAYER_ENEMY_BULLETS
+};
+
 enum BossState {
     BOSS_NORMAL,
     BOSS_SHIELDED,
@@ -53,35 +143,156 @@ const int BOSS_INITIAL_HEALTH = 1000;
 const int SHIELD_DURATION = 240;
 const int LASER_DURATION = 90;
 const int MISSILE_DURATION = 180;
+const int MISSILE_WIDTH = 30;
+const int MISSILE_HEIGHT = 50;
+const int ENEMY_BULLET_WIDTH = 20;
+const int ENEMY_BULLET_HEIGHT = 50;
+const int SPIRAL_BULLET_SIZE = 20;
+const int LASER_WIDTH = 160;
+const int LASER_HEIGHT = SCREEN_HEIGHT - (BOSS_HEIGHT + 100);
+const int LIFE_ICON_SIZE = 30;
+const int MAX_HOMING_PROJECTILES = 4096;
+const int MISSILE_SWARM_SIZE = 24;
+const int TIMER_WHEEL_SLOTS = 1024;
+const int MAX_TIMER_EVENTS = 64;
+const float SKILL_CAST_CHANCE = 0.2f;
+const double FRAME_BUDGET_MS = 16.6;
+const float MIN_RENDER_SCALE = 0.5f;
+const float RENDER_SCALE_STEP = 0.1f;
+const int SCALE_DOWN_FRAMES = 5;
+const int SCALE_UP_FRAMES = 120;
+const size_t DEFAULT_TEXTURE_BUDGET_MB = 32;
+const char* const SPRITE_CACHE_DIR = "sprite_cache";
+const int MAX_PARTICLES = 16384;
+const int MAX_PARTICLE_SIZE = 16;
+const int ENTITY_RESERVE = 512;
+const size_t FRAME_ARENA_SIZE = 64 * 1024;
+const int ALLOCATION_WARMUP_FRAMES = 120;
+const int MAX_PENDING_INPUTS = 32;
+const int LATENCY_SAMPLES = 1024;
+const int LATENCY_REPORT_INTERVAL = 256;
+const Uint32 FRAME_DELAY_MS = 16;
+const double FRAME_PERIOD_SECONDS = 1.0 / 60;
+const int RENDER_BATCH_QUADS = 4096;
+const int CAPTURE_BUFFER_COUNT = 6;
+const Uint32 EVENT_RING_SIZE = 1024; // power of two
 
 struct GameObject {
     int x, y, w, h;
     bool active = true;
+    int firePattern = FIRE_RANDOM;
 };
 
-struct Explosion {
-    int x, y;
-    int frame = 0;
+// On-disk wave timeline, produced by --compile-waves: a header followed by
+// records sorted by tick. The file is mapped read-only and walked with a
+// cursor, so nothing is parsed or copied at load time.
+const Uint32 WAVE_FILE_MAGIC = 0x45564157; // "WAVE"
+const Uint32 WAVE_FILE_VERSION = 1;
+
+struct WaveFileHeader {
+    Uint32 magic;
+    Uint32 version;
+    Uint32 recordCount;
+    Uint32 reserved;
+};
+
+struct WaveRecord {
+    Uint32 tick;
+    Uint16 formation;
+    Uint16 enemyType;
+    Sint16 x;
+    Sint16 y;
+    Uint16 firePattern;
+    Uint16 reserved;
+};
+
+static_assert(sizeof(WaveFileHeader) == 16, "wave file header layout changed");
+static_assert(sizeof(WaveRecord) == 16, "wave record layout changed");
+
+struct WaveTimeline {
+    const WaveRecord* records = NULL;
+    Uint32 count = 0;
+    Uint32 cursor = 0;
+    Uint32 tick = 0;
+    void* mapping = NULL;
+    size_t mappingSize = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE fileMapping = NULL;
+#endif
+};
+
+// Fixed-capacity structure-of-arrays pool; live particles are kept packed in
+// [0, count) so the update loops run over contiguous floats.
+struct ParticleSystem {
+    int count = 0;
+    float x[MAX_PARTICLES];
+    float y[MAX_PARTICLES];
+    float vx[MAX_PARTICLES];
+    float vy[MAX_PARTICLES];
+    float life[MAX_PARTICLES];
+    float invMaxLife[MAX_PARTICLES];
+    float size[MAX_PARTICLES];
+    Uint8 r[MAX_PARTICLES];
+    Uint8 g[MAX_PARTICLES];
+    Uint8 b[MAX_PARTICLES];
+    vector<SDL_Vertex> vertices;
+    vector<int> indices;
 };
 
 struct Laser {
     int x, y;
     int width, height;
     bool active;
-    int timer;
+    Uint32 expireTick;
+};
+
+enum BossEventType {
+    EVENT_CAST_SKILL,
+    EVENT_SHIELD_END,
+    EVENT_LASER_END,
+    EVENT_PHASE_CHANGE
+};
+
+struct TimerEvent {
+    Uint32 due;
+    BossEventType type;
+    int data;
+    int next;
+};
+
+// Hashed timer wheel: an event lives in slot due % TIMER_WHEEL_SLOTS and is
+// only looked at on the tick its slot comes round, so a tick costs the
+// number of events in one slot rather than the number scheduled.
+struct TimerWheel {
+    Uint32 now = 0;
+    int slots[TIMER_WHEEL_SLOTS];
+    TimerEvent events[MAX_TIMER_EVENTS];
+    int freeList = -1;
+};
+
+// Homing projectiles in structure-of-arrays form. Position is the sprite
+// centre; (dirX, dirY) is a unit heading that turns towards the target by at
+// most turnRate radians per frame, stored as its cosine and sine.
+struct HomingProjectiles {
+    int count = 0;
+    vector<float> x, y;
+    vector<float> dirX, dirY;
+    vector<float> speed, maxSpeed, accel;
+    vector<float> cosTurn, sinTurn;
+    vector<float> life;
 };
 
 struct Boss {
     int x, y;
     int health;
     BossState state;
-    int shieldTimer;
-    int skillCooldowns[SKILL_COUNT];
+    Uint32 shieldEndTick;
     int phase;
     int attackPattern;
     int laserTimer;
     vector<Laser> lasers;
-    vector<GameObject> missiles;
+    HomingProjectiles missiles;
     vector<GameObject> spiralBullets;
     vector<GameObject> minions;
     int speedX = 3;
@@ -89,6 +300,226 @@ struct Boss {
     int moveDirection = 1;
     int moveRange = 300;
     int initialX;
+    TimerWheel scheduler;
+};
+
+// Linear buffer for strings that only live until the end of the frame.
+struct FrameArena {
+    vector<char> memory;
+    size_t used = 0;
+};
+
+// Input-to-photon latency: key/button presses wait in pending until the next
+// SDL_RenderPresent, which closes them into the samples rings.
+// SDL only sees OS input when events are pumped, and event timestamps are
+// taken at that point, not when the key went down. A press delivered by a
+// pump therefore happened somewhere between the previous pump and this one.
+// The pump time gives the lower bound, the previous pump the upper bound.
+struct InputLatencyStats {
+    Uint64 previousPump = 0;
+    Uint64 currentPump = 0;
+    Uint64 pendingEarliest[MAX_PENDING_INPUTS];
+    Uint64 pendingLatest[MAX_PENDING_INPUTS];
+    int pendingCount = 0;
+    float samples[LATENCY_SAMPLES];
+    float pumpSamples[LATENCY_SAMPLES];
+    int sampleCount = 0;
+    int nextSample = 0;
+    int sinceReport = 0;
+};
+
+enum FramePacing {
+    PACING_DELAY_AFTER_PRESENT,
+    PACING_SLEEP_BEFORE_INPUT
+};
+
+struct FramePacer {
+    FramePacing mode = PACING_DELAY_AFTER_PRESENT;
+    Uint64 nextFrame = 0;
+};
+
+struct RenderCommand {
+    int layer;
+    SDL_Texture* texture;
+    SDL_Rect rect;
+    Uint32 order;
+};
+
+struct RenderQueue {
+    vector<RenderCommand> commands;
+    vector<SDL_Vertex> vertices;
+    vector<int> indices;
+};
+
+enum TextureId {
+    TEX_PLAYER,
+    TEX_LIFE_ICON,
+    TEX_BULLET,
+    TEX_ENEMY,
+    TEX_BACKGROUND,
+    TEX_ENEMY_BULLET,
+    TEX_EXPLOSION,
+    TEX_START,
+    TEX_GAME_OVER,
+    TEX_BOSS,
+    TEX_BOSS_SHIELD,
+    TEX_BOSS_MISSILE,
+    TEX_SPIRAL_BULLET,
+    TEX_LASER,
+    TEX_MENU_BACKGROUND,
+    TEXTURE_COUNT
+};
+
+// width/height is the size the sprite is always drawn at; the texture is
+// built at exactly that size so draws are 1:1 copies. 0 keeps the source size.
+struct TextureAsset {
+    const char* path;
+    int modes;
+    SDL_BlendMode blendMode;
+    int width, height;
+};
+
+const int MODE_MENU = 1 << MENU;
+const int MODE_SURVIVAL = 1 << SURVIVAL;
+const int MODE_BOSS = 1 << BOSS;
+
+const TextureAsset TEXTURE_ASSETS[TEXTURE_COUNT] = {
+    { "tàu.png", MODE_SURVIVAL | MODE_BOSS, SDL_BLENDMODE_BLEND, PLAYER_WIDTH, PLAYER_HEIGHT },
+    { "tàu.png", MODE_SURVIVAL | MODE_BOSS, SDL_BLENDMODE_BLEND, LIFE_ICON_SIZE, LIFE_ICON_SIZE },
+    { "đạn.png", MODE_SURVIVAL | MODE_BOSS, SDL_BLENDMODE_BLEND, BULLET_WIDTH, BULLET_HEIGHT },
+    { "địch.png", MODE_SURVIVAL | MODE_BOSS, SDL_BLENDMODE_BLEND, ENEMY_WIDTH, ENEMY_HEIGHT },
+    { "nền.png", MODE_SURVIVAL | MODE_BOSS, SDL_BLENDMODE_BLEND, SCREEN_WIDTH, SCREEN_HEIGHT },
+    { "đạn địch.png", MODE_SURVIVAL | MODE_BOSS, SDL_BLENDMODE_BLEND, ENEMY_BULLET_WIDTH, ENEMY_BULLET_HEIGHT },
+    { "địch nổ.png", MODE_SURVIVAL | MODE_BOSS, SDL_BLENDMODE_ADD, MAX_PARTICLE_SIZE, MAX_PARTICLE_SIZE },
+    { "fight.png", MODE_MENU, SDL_BLENDMODE_BLEND, SCREEN_WIDTH, SCREEN_HEIGHT },
+    { "over.png", MODE_SURVIVAL | MODE_BOSS, SDL_BLENDMODE_BLEND, SCREEN_WIDTH, SCREEN_HEIGHT },
+    { "boss1.png", MODE_BOSS, SDL_BLENDMODE_BLEND, BOSS_WIDTH, BOSS_HEIGHT },
+    { "khiên.png", MODE_BOSS, SDL_BLENDMODE_BLEND, BOSS_WIDTH, BOSS_HEIGHT },
+    { "tên lửa boss.png", MODE_BOSS, SDL_BLENDMODE_BLEND, MISSILE_WIDTH, MISSILE_HEIGHT },
+    { "tên lửa boss.png", MODE_BOSS, SDL_BLENDMODE_BLEND, SPIRAL_BULLET_SIZE, SPIRAL_BULLET_SIZE },
+    { "laze.png", MODE_BOSS, SDL_BLENDMODE_BLEND, LASER_WIDTH, LASER_HEIGHT },
+    { "menu.png", MODE_MENU, SDL_BLENDMODE_BLEND, SCREEN_WIDTH, SCREEN_HEIGHT }
+};
+
+struct TextureEntry {
+    SDL_Texture* texture = NULL;
+    size_t bytes = 0;
+    Uint64 lastUsedFrame = 0;
+    bool failed = false;
+};
+
+// Loads textures on first use (or when a mode is entered) and evicts the
+// least recently used ones once resident bytes exceed the budget. Textures
+// used in the current frame are never evicted, since the render queue may
+// still hold them.
+struct TextureManager {
+    SDL_Renderer* renderer = NULL;
+    TextureEntry entries[TEXTURE_COUNT];
+    size_t budgetBytes = 0;
+    size_t gpuBytes = 0;
+    size_t cpuBytes = 0;
+    bool softwareRenderer = false;
+    Uint64 frame = 1;
+    int loads = 0;
+    int evictions = 0;
+    int misses = 0;
+    int prescaled = 0;
+    int cacheHits = 0;
+};
+
+// Gameplay is drawn in logical 1200x800 coordinates into the top-left
+// scale * (1200x800) corner of an offscreen target and stretched to the
+// window afterwards. The scale follows measured frame time.
+struct ResolutionScaler {
+    SDL_Texture* target = NULL;
+    float scale = 1.0f;
+    Uint64 frameStart = 0;
+    int overBudgetFrames = 0;
+    int headroomFrames = 0;
+    bool active = false;
+};
+
+// Frames are read back on the render thread into a fixed pool of buffers and
+// handed to a writer thread that converts them to Y4M. If every buffer is
+// still queued the frame is dropped instead of waiting for the disk.
+struct CaptureRecorder {
+    FILE* file = NULL;
+    int width = 0;
+    int height = 0;
+    vector<Uint8> buffers[CAPTURE_BUFFER_COUNT];
+    vector<Uint8> yuv;
+    int freeBuffers[CAPTURE_BUFFER_COUNT];
+    int freeCount = 0;
+    int readyBuffers[CAPTURE_BUFFER_COUNT];
+    int readyHead = 0;
+    int readyCount = 0;
+    SDL_mutex* lock = NULL;
+    SDL_cond* wake = NULL;
+    SDL_Thread* writer = NULL;
+    bool stopping = false;
+    int captured = 0;
+    int dropped = 0;
+    int written = 0;
+    bool writeFailed = false;
+};
+
+enum GameEventType {
+    GAME_EVENT_SHOT,
+    GAME_EVENT_ENEMY_KILLED,
+    GAME_EVENT_PLAYER_HIT,
+    GAME_EVENT_BOSS_DAMAGED,
+    GAME_EVENT_BOSS_KILLED,
+    GAME_EVENT_GAME_OVER,
+    GAME_EVENT_COUNT
+};
+
+struct GameEvent {
+    GameEventType type;
+    float x, y;
+    int value;
+};
+
+// Single-producer/single-consumer ring. A full ring drops the event and
+// counts it rather than making the simulation wait on a consumer.
+struct EventRing {
+    GameEvent events[EVENT_RING_SIZE];
+    atomic<Uint32> head{ 0 };
+    atomic<Uint32> tail{ 0 };
+    atomic<Uint32> dropped{ 0 };
+};
+
+enum EventConsumer {
+    CONSUMER_SCORING,
+    CONSUMER_AUDIO,
+    CONSUMER_EFFECTS,
+    CONSUMER_TELEMETRY,
+    CONSUMER_COUNT
+};
+
+const int CONSUMER_SUBSCRIPTIONS[CONSUMER_COUNT] = {
+    (1 << GAME_EVENT_ENEMY_KILLED) | (1 << GAME_EVENT_BOSS_KILLED) | (1 << GAME_EVENT_GAME_OVER),
+    (1 << GAME_EVENT_SHOT) | (1 << GAME_EVENT_ENEMY_KILLED) | (1 << GAME_EVENT_PLAYER_HIT) | (1 << GAME_EVENT_BOSS_DAMAGED) | (1 << GAME_EVENT_BOSS_KILLED),
+    (1 << GAME_EVENT_ENEMY_KILLED) | (1 << GAME_EVENT_BOSS_KILLED),
+    (1 << GAME_EVENT_COUNT) - 1
+};
+
+// Gameplay publishes what happened; scoring, audio, particles and telemetry
+// each drain their own ring when they get to it.
+struct EventBus {
+    EventRing rings[CONSUMER_COUNT];
+    Uint64 counts[GAME_EVENT_COUNT] = {};
+};
+
+struct GlyphAtlas {
+    SDL_Texture* glyphs[128] = {};
+    int widths[128] = {};
+    int height = 0;
+};
+
+struct CollisionMask {
+    int w = 0, h = 0;
+    int wordsPerRow = 0;
+    vector<Uint64> bits;
 };
 
 struct Player {
@@ -105,45 +536,941 @@ struct Player {
     void moveDown() { if (y < SCREEN_HEIGHT - PLAYER_HEIGHT) y += speed; }
 };
 
+CollisionMask playerMask;
+CollisionMask bulletMask;
+CollisionMask enemyMask;
+CollisionMask enemyBulletMask;
+CollisionMask bossMask;
+CollisionMask shieldMask;
+CollisionMask bossMissileMask;
+CollisionMask spiralBulletMask;
+CollisionMask laserMask;
+
+// Masks are built alongside their texture, so boss masks cost nothing until
+// the boss mode is entered.
+CollisionMask* const TEXTURE_MASKS[TEXTURE_COUNT] = {
+    &playerMask, NULL, &bulletMask, &enemyMask, NULL, &enemyBulletMask, NULL, NULL, NULL,
+    &bossMask, &shieldMask, &bossMissileMask, &spiralBulletMask, &laserMask, NULL
+};
+
 vector<GameObject> bullets;
 vector<GameObject> enemies;
 vector<GameObject> enemyBullets;
-vector<Explosion> explosions;
+ParticleSystem particles;
+FrameArena frameArena;
+RenderQueue renderQueue;
+WaveTimeline waveTimeline;
+CaptureRecorder capture;
+EventBus gameEvents;
 
 int enemyWaveCount = 0;
 int highScore = 0;
 
-void updateExplosions(vector<Explosion>& explosions) {
-    for (auto& explosion : explosions) {
-        explosion.frame++;
+void initFrameArena(FrameArena& arena, size_t size) {
+    arena.memory.resize(size);
+    arena.used = 0;
+}
+
+// printf into the frame arena; the result is valid until the next reset.
+const char* arenaFormat(FrameArena& arena, const char* format, ...) {
+    size_t available = arena.memory.size() - arena.used;
+    if (available == 0) return "";
+    char* out = arena.memory.data() + arena.used;
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(out, available, format, args);
+    va_end(args);
+
+    if (length < 0) return "";
+    arena.used += min(available, size_t(length) + 1);
+    return out;
+}
+
+// Call right before every SDL_PollEvent loop.
+void markInputPump(InputLatencyStats& stats) {
+    stats.previousPump = stats.currentPump;
+    stats.currentPump = SDL_GetPerformanceCounter();
+    if (stats.previousPump == 0) stats.previousPump = stats.currentPump;
+}
+
+void recordInputEvent(InputLatencyStats& stats, const SDL_Event& event) {
+    bool press = (event.type == SDL_KEYDOWN && !event.key.repeat) || event.type == SDL_MOUSEBUTTONDOWN;
+    if (!press || stats.pendingCount == MAX_PENDING_INPUTS) return;
+    stats.pendingEarliest[stats.pendingCount] = stats.previousPump;
+    stats.pendingLatest[stats.pendingCount] = stats.currentPump;
+    stats.pendingCount++;
+}
+
+void latencyPercentiles(const float* samples, int n, float& p50, float& p99) {
+    float sorted[LATENCY_SAMPLES];
+    copy(samples, samples + n, sorted);
+    nth_element(sorted, sorted + n / 2, sorted + n);
+    p50 = sorted[n / 2];
+    int p99Index = min(n - 1, n * 99 / 100);
+    nth_element(sorted, sorted + p99Index, sorted + n);
+    p99 = sorted[p99Index];
+}
+
+void reportInputLatency(const InputLatencyStats& stats) {
+    if (stats.sampleCount == 0) return;
+
+    float p50, p99, pumpP50, pumpP99;
+    latencyPercentiles(stats.samples, stats.sampleCount, p50, p99);
+    latencyPercentiles(stats.pumpSamples, stats.sampleCount, pumpP50, pumpP99);
+    printf("Input latency over last %d presses: p50 %.1f ms, p99 %.1f ms (from previous pump); "
+           "p50 %.1f ms, p99 %.1f ms (from delivering pump)\n",
+           stats.sampleCount, p50, p99, pumpP50, pumpP99);
+}
+
+// Call right after every SDL_RenderPresent.
+void recordPresent(InputLatencyStats& stats) {
+    if (stats.pendingCount == 0) return;
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    double toMs = 1000.0 / SDL_GetPerformanceFrequency();
+    for (int i = 0; i < stats.pendingCount; i++) {
+        stats.samples[stats.nextSample] = float((now - stats.pendingEarliest[i]) * toMs);
+        stats.pumpSamples[stats.nextSample] = float((now - stats.pendingLatest[i]) * toMs);
+        stats.nextSample = (stats.nextSample + 1) % LATENCY_SAMPLES;
+        stats.sampleCount = min(stats.sampleCount + 1, LATENCY_SAMPLES);
+        stats.sinceReport++;
+    }
+    stats.pendingCount = 0;
+
+    if (stats.sinceReport >= LATENCY_REPORT_INTERVAL) {
+        reportInputLatency(stats);
+        stats.sinceReport = 0;
+    }
+}
+
+// PACING_DELAY_AFTER_PRESENT is the original fixed SDL_Delay at the end of
+// the frame. PACING_SLEEP_BEFORE_INPUT sleeps at the top of the frame until
+// the next 60 Hz deadline, so input is polled as late as possible and the
+// present follows it without a sleep in between.
+void beginFrame(FramePacer& pacer) {
+    if (pacer.mode != PACING_SLEEP_BEFORE_INPUT) return;
+
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 period = Uint64(frequency * FRAME_PERIOD_SECONDS);
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (pacer.nextFrame == 0 || now > pacer.nextFrame + period) {
+        pacer.nextFrame = now;
+    }
+
+    while (now < pacer.nextFrame) {
+        Uint64 remainingMs = (pacer.nextFrame - now) * 1000 / frequency;
+        if (remainingMs > 2) {
+            SDL_Delay(Uint32(remainingMs - 2));
+        }
+        now = SDL_GetPerformanceCounter();
+    }
+    pacer.nextFrame += period;
+}
+
+void endFrame(const FramePacer& pacer) {
+    if (pacer.mode == PACING_DELAY_AFTER_PRESENT) {
+        SDL_Delay(FRAME_DELAY_MS);
+    }
+}
+
+#ifdef GAME1_TRACK_ALLOCATIONS
+struct FrameAllocationTracker {
+    size_t frameStart = 0;
+    long long frame = 0;
+    int gameplayFrames = 0;
+};
+
+// Called once per loop iteration; reports the previous frame if it was a
+// gameplay frame past the warm-up and hit the heap.
+void trackFrameAllocations(FrameAllocationTracker& tracker, bool gameplay) {
+    size_t allocations = allocationCount - tracker.frameStart;
+    tracker.frame++;
+
+    if (!gameplay) {
+        tracker.gameplayFrames = 0;
+    } else if (tracker.gameplayFrames++ >= ALLOCATION_WARMUP_FRAMES && allocations > 0) {
+        cout << "Frame " << tracker.frame << ": " << allocations << " heap allocations" << endl;
+#ifdef GAME1_ASSERT_NO_ALLOCATIONS
+        SDL_assert(allocations == 0);
+#endif
+    }
+    tracker.frameStart = allocationCount;
+}
+#endif
+
+// Builds a 1-bit mask from a sprite surface already at its draw size, one
+// bit per pixel (bit 0 of word 0 is the leftmost column). Pixels with
+// alpha >= alphaThreshold are solid. Without a surface the mask is fully
+// solid, which keeps the old AABB behaviour for that sprite.
+CollisionMask buildCollisionMask(SDL_Surface* sprite, int w, int h, Uint8 alphaThreshold = 128) {
+    CollisionMask mask;
+    mask.w = w;
+    mask.h = h;
+    mask.wordsPerRow = (w + 63) / 64;
+    mask.bits.assign(mask.wordsPerRow * h, 0);
+
+    SDL_Surface* surface = (sprite && sprite->w == w && sprite->h == h)
+        ? SDL_ConvertSurfaceFormat(sprite, SDL_PIXELFORMAT_RGBA32, 0) : NULL;
+    if (!surface) {
+        cout << "Failed to build " << w << "x" << h << " collision mask, using box" << endl;
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                mask.bits[y * mask.wordsPerRow + x / 64] |= Uint64(1) << (x % 64);
+            }
+        }
+        return mask;
+    }
+
+    SDL_LockSurface(surface);
+    const Uint8* pixels = static_cast<const Uint8*>(surface->pixels);
+    for (int y = 0; y < h; y++) {
+        const Uint8* srcRow = pixels + y * surface->pitch;
+        for (int x = 0; x < w; x++) {
+            if (srcRow[x * 4 + 3] >= alphaThreshold) {
+                mask.bits[y * mask.wordsPerRow + x / 64] |= Uint64(1) << (x % 64);
+            }
+        }
+    }
+    SDL_UnlockSurface(surface);
+    SDL_FreeSurface(surface);
+    return mask;
+}
+
+// Returns the 64 mask bits of a row starting at column x; columns past the
+// right edge read as zero.
+inline Uint64 maskRowBits(const CollisionMask& mask, int row, int x) {
+    const Uint64* words = &mask.bits[row * mask.wordsPerRow];
+    int word = x / 64;
+    int shift = x % 64;
+    Uint64 result = words[word] >> shift;
+    if (shift != 0 && word + 1 < mask.wordsPerRow) {
+        result |= words[word + 1] << (64 - shift);
     }
-    explosions.erase(remove_if(explosions.begin(), explosions.end(),
-        [](const Explosion& e) { return e.frame > 15; }), explosions.end());
+    return result;
+}
+
+bool masksOverlap(const CollisionMask& a, int ax, int ay, const CollisionMask& b, int bx, int by) {
+    int left = max(ax, bx);
+    int right = min(ax + a.w, bx + b.w);
+    int top = max(ay, by);
+    int bottom = min(ay + a.h, by + b.h);
+    if (left >= right || top >= bottom) return false;
+
+    for (int y = top; y < bottom; y++) {
+        int rowA = y - ay;
+        int rowB = y - by;
+        for (int x = left; x < right; x += 64) {
+            Uint64 overlap = maskRowBits(a, rowA, x - ax) & maskRowBits(b, rowB, x - bx);
+            int remaining = right - x;
+            if (remaining < 64) overlap &= (Uint64(1) << remaining) - 1;
+            if (overlap) return true;
+        }
+    }
+    return false;
+}
+
+// AABB broadphase first; the masks are only consulted when the boxes touch.
+bool spritesCollide(const SDL_Rect& a, const CollisionMask& maskA, const SDL_Rect& b, const CollisionMask& maskB) {
+    if (!SDL_HasIntersection(&a, &b)) return false;
+    return masksOverlap(maskA, a.x, a.y, maskB, b.x, b.y);
+}
+
+// Two triangles per quad with fixed indices and tex coords; callers only
+// fill in positions (and colours) before SDL_RenderGeometry.
+void initQuadMesh(vector<SDL_Vertex>& vertices, vector<int>& indices, int quads) {
+    vertices.resize(quads * 4);
+    indices.resize(quads * 6);
+    for (int i = 0; i < quads; i++) {
+        int v = i * 4;
+        int* idx = &indices[i * 6];
+        idx[0] = v; idx[1] = v + 1; idx[2] = v + 2;
+        idx[3] = v + 2; idx[4] = v + 3; idx[5] = v;
+        vertices[v].tex_coord = { 0, 0 };
+        vertices[v + 1].tex_coord = { 1, 0 };
+        vertices[v + 2].tex_coord = { 1, 1 };
+        vertices[v + 3].tex_coord = { 0, 1 };
+        for (int k = 0; k < 4; k++) {
+            vertices[v + k].color = { 255, 255, 255, 255 };
+        }
+    }
+}
+
+void initParticles(ParticleSystem& ps) {
+    ps.count = 0;
+    initQuadMesh(ps.vertices, ps.indices, MAX_PARTICLES);
+}
+
+void emitExplosion(ParticleSystem& ps, float cx, float cy, int amount, float speed, SDL_Color color) {
+    for (int n = 0; n < amount && ps.count < MAX_PARTICLES; n++) {
+        int i = ps.count++;
+        float angle = (rand() % 628) * 0.01f;
+        float v = speed * (0.25f + (rand() % 100) * 0.0075f);
+        float lifetime = 20.0f + rand() % 25;
+        ps.x[i] = cx;
+        ps.y[i] = cy;
+        ps.vx[i] = v * cos(angle);
+        ps.vy[i] = v * sin(angle);
+        ps.life[i] = lifetime;
+        ps.invMaxLife[i] = 1.0f / lifetime;
+        ps.size[i] = 6.0f + rand() % (MAX_PARTICLE_SIZE - 6);
+        ps.r[i] = color.r;
+        ps.g[i] = max(0, color.g - rand() % 120);
+        ps.b[i] = color.b;
+    }
+}
+
+void updateParticles(ParticleSystem& ps) {
+    int count = ps.count;
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 drag = _mm_set1_ps(0.96f);
+    const __m128 gravity = _mm_set1_ps(0.05f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(ps.vx + i);
+        __m128 vy = _mm_loadu_ps(ps.vy + i);
+        _mm_storeu_ps(ps.x + i, _mm_add_ps(_mm_loadu_ps(ps.x + i), vx));
+        _mm_storeu_ps(ps.y + i, _mm_add_ps(_mm_loadu_ps(ps.y + i), vy));
+        _mm_storeu_ps(ps.vx + i, _mm_mul_ps(vx, drag));
+        _mm_storeu_ps(ps.vy + i, _mm_add_ps(_mm_mul_ps(vy, drag), gravity));
+        _mm_storeu_ps(ps.life + i, _mm_sub_ps(_mm_loadu_ps(ps.life + i), one));
+    }
+#endif
+    for (; i < count; i++) {
+        ps.x[i] += ps.vx[i];
+        ps.y[i] += ps.vy[i];
+        ps.vx[i] *= 0.96f;
+        ps.vy[i] = ps.vy[i] * 0.96f + 0.05f;
+        ps.life[i] -= 1.0f;
+    }
+
+    i = 0;
+    while (i < count) {
+        if (ps.life[i] > 0) {
+            i++;
+            continue;
+        }
+        count--;
+        ps.x[i] = ps.x[count];
+        ps.y[i] = ps.y[count];
+        ps.vx[i] = ps.vx[count];
+        ps.vy[i] = ps.vy[count];
+        ps.life[i] = ps.life[count];
+        ps.invMaxLife[i] = ps.invMaxLife[count];
+        ps.size[i] = ps.size[count];
+        ps.r[i] = ps.r[count];
+        ps.g[i] = ps.g[count];
+        ps.b[i] = ps.b[count];
+    }
+    ps.count = count;
+}
+
+// One SDL_RenderGeometry call for every live particle.
+void renderParticles(SDL_Renderer* renderer, ParticleSystem& ps, SDL_Texture* texture) {
+    if (ps.count == 0) return;
+
+    SDL_Vertex* vertices = ps.vertices.data();
+    for (int i = 0; i < ps.count; i++) {
+        float half = ps.size[i] * 0.5f;
+        float left = ps.x[i] - half, right = ps.x[i] + half;
+        float top = ps.y[i] - half, bottom = ps.y[i] + half;
+        SDL_Color color = { ps.r[i], ps.g[i], ps.b[i], Uint8(255 * ps.life[i] * ps.invMaxLife[i]) };
+        SDL_Vertex* v = &vertices[i * 4];
+        v[0].position = { left, top };
+        v[1].position = { right, top };
+        v[2].position = { right, bottom };
+        v[3].position = { left, bottom };
+        v[0].color = v[1].color = v[2].color = v[3].color = color;
+    }
+    SDL_RenderGeometry(renderer, texture, vertices, ps.count * 4, ps.indices.data(), ps.count * 6);
+}
+
+bool pushEvent(EventRing& ring, const GameEvent& event) {
+    Uint32 tail = ring.tail.load(memory_order_relaxed);
+    if (tail - ring.head.load(memory_order_acquire) == EVENT_RING_SIZE) {
+        ring.dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    ring.events[tail & (EVENT_RING_SIZE - 1)] = event;
+    ring.tail.store(tail + 1, memory_order_release);
+    return true;
+}
+
+bool popEvent(EventRing& ring, GameEvent& event) {
+    Uint32 head = ring.head.load(memory_order_relaxed);
+    if (head == ring.tail.load(memory_order_acquire)) return false;
+    event = ring.events[head & (EVENT_RING_SIZE - 1)];
+    ring.head.store(head + 1, memory_order_release);
+    return true;
+}
+
+void publishEvent(GameEventType type, float x = 0, float y = 0, int value = 0) {
+    GameEvent event = { type, x, y, value };
+    for (int c = 0; c < CONSUMER_COUNT; c++) {
+        if (CONSUMER_SUBSCRIPTIONS[c] & (1 << type)) pushEvent(gameEvents.rings[c], event);
+    }
+}
+
+// Only call while no consumer is draining.
+void resetEventBus(EventBus& bus) {
+    for (auto& ring : bus.rings) {
+        ring.head.store(ring.tail.load());
+    }
+}
+
+// Callers check invincibility first; some of them also consume the projectile.
+void hitPlayer(Player& player) {
+    player.lives--;
+    player.invincible = true;
+    player.invincibleTimer = 90;
+    publishEvent(GAME_EVENT_PLAYER_HIT, player.x + PLAYER_WIDTH / 2, player.y + PLAYER_HEIGHT / 2);
+}
+
+void drainScoreEvents(Player& player) {
+    GameEvent event;
+    while (popEvent(gameEvents.rings[CONSUMER_SCORING], event)) {
+        if (event.type == GAME_EVENT_GAME_OVER) {
+            if (player.score > highScore) {
+                highScore = player.score;
+                ofstream out("highscore.txt");
+                out << highScore;
+                out.close();
+            }
+        } else {
+            player.score += event.value;
+        }
+    }
+}
+
+void drainAudioEvents() {
+    GameEvent event;
+    while (popEvent(gameEvents.rings[CONSUMER_AUDIO], event)) {
+        switch (event.type) {
+        case GAME_EVENT_SHOT:
+            Mix_PlayChannel(-1, soundShoot, 0);
+            break;
+        case GAME_EVENT_PLAYER_HIT:
+        case GAME_EVENT_BOSS_DAMAGED:
+            Mix_PlayChannel(-1, soundHit, 0);
+            break;
+        case GAME_EVENT_ENEMY_KILLED:
+        case GAME_EVENT_BOSS_KILLED:
+            Mix_PlayChannel(-1, soundExplode, 0);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void drainEffectEvents(ParticleSystem& ps) {
+    GameEvent event;
+    while (popEvent(gameEvents.rings[CONSUMER_EFFECTS], event)) {
+        if (event.type == GAME_EVENT_BOSS_KILLED) {
+            emitExplosion(ps, event.x, event.y, 600, 9.0f, SDL_Color{ 255, 160, 60, 255 });
+        } else {
+            emitExplosion(ps, event.x, event.y, 48, 4.0f, SDL_Color{ 255, 200, 80, 255 });
+        }
+    }
+}
+
+void drainTelemetryEvents() {
+    GameEvent event;
+    while (popEvent(gameEvents.rings[CONSUMER_TELEMETRY], event)) {
+        gameEvents.counts[event.type]++;
+    }
+}
+
+void reportEventTelemetry(const EventBus& bus) {
+    const char* names[GAME_EVENT_COUNT] = { "shot", "enemy_killed", "player_hit", "boss_damaged", "boss_killed", "game_over" };
+    printf("Events:");
+    for (int i = 0; i < GAME_EVENT_COUNT; i++) {
+        printf(" %s=%llu", names[i], (unsigned long long)bus.counts[i]);
+    }
+    printf(", dropped scoring=%u audio=%u effects=%u telemetry=%u\n",
+           bus.rings[CONSUMER_SCORING].dropped.load(), bus.rings[CONSUMER_AUDIO].dropped.load(),
+           bus.rings[CONSUMER_EFFECTS].dropped.load(), bus.rings[CONSUMER_TELEMETRY].dropped.load());
 }
 
 void spawnEnemyBullet(GameObject& enemy) {
-    GameObject bullet = { enemy.x + enemy.w / 2 - 10, enemy.y + enemy.h, 20, 50, true };
+    GameObject bullet = { enemy.x + enemy.w / 2 - ENEMY_BULLET_WIDTH / 2, enemy.y + enemy.h, ENEMY_BULLET_WIDTH, ENEMY_BULLET_HEIGHT, true };
     enemyBullets.push_back(bullet);
 }
 
-void spawnEnemyWave() {
-    enemyWaveCount++;
-    if (enemyWaveCount % 10 == 0) {
-        int spacing = 90;
-        int startX = 100;
-        for (int i = 0; i < 5; ++i) {
-            enemies.push_back({ startX + i * spacing, 0, ENEMY_WIDTH, ENEMY_HEIGHT, true });
-        }
-    } else if (enemyWaveCount % 15 == 0) {
-        int centerX = SCREEN_WIDTH / 2;
-        enemies.push_back({ centerX - ENEMY_WIDTH / 2, 0, ENEMY_WIDTH, ENEMY_HEIGHT, true });
-        enemies.push_back({ centerX - ENEMY_WIDTH - 20, -ENEMY_HEIGHT, ENEMY_WIDTH, ENEMY_HEIGHT, true });
-        enemies.push_back({ centerX + 20, -ENEMY_HEIGHT, ENEMY_WIDTH, ENEMY_HEIGHT, true });
-        enemies.push_back({ centerX - 2 * ENEMY_WIDTH - 40, -2 * ENEMY_HEIGHT, ENEMY_WIDTH, ENEMY_HEIGHT, true });
-        enemies.push_back({ centerX + 2 * ENEMY_WIDTH + 40 - ENEMY_WIDTH, -2 * ENEMY_HEIGHT, ENEMY_WIDTH, ENEMY_HEIGHT, true });
-    } else {
-        int xPos = rand() % (SCREEN_WIDTH - ENEMY_WIDTH);
-        enemies.push_back({ xPos, 0, ENEMY_WIDTH, ENEMY_HEIGHT, true });
+void spawnFormation(int formation, int x, int y, int firePattern) {
+    if (formation == FORMATION_LINE) {
+        int spacing = 90;
+        for (int i = 0; i < 5; ++i) {
+            enemies.push_back({ x + i * spacing, y, ENEMY_WIDTH, ENEMY_HEIGHT, true, firePattern });
+        }
+    } else if (formation == FORMATION_ARROW) {
+        enemies.push_back({ x - ENEMY_WIDTH / 2, y, ENEMY_WIDTH, ENEMY_HEIGHT, true, firePattern });
+        enemies.push_back({ x - ENEMY_WIDTH - 20, y - ENEMY_HEIGHT, ENEMY_WIDTH, ENEMY_HEIGHT, true, firePattern });
+        enemies.push_back({ x + 20, y - ENEMY_HEIGHT, ENEMY_WIDTH, ENEMY_HEIGHT, true, firePattern });
+        enemies.push_back({ x - 2 * ENEMY_WIDTH - 40, y - 2 * ENEMY_HEIGHT, ENEMY_WIDTH, ENEMY_HEIGHT, true, firePattern });
+        enemies.push_back({ x + 2 * ENEMY_WIDTH + 40 - ENEMY_WIDTH, y - 2 * ENEMY_HEIGHT, ENEMY_WIDTH, ENEMY_HEIGHT, true, firePattern });
+    } else {
+        enemies.push_back({ x, y, ENEMY_WIDTH, ENEMY_HEIGHT, true, firePattern });
+    }
+}
+
+void spawnEnemyWave() {
+    enemyWaveCount++;
+    if (enemyWaveCount % 10 == 0) {
+        spawnFormation(FORMATION_LINE, 100, 0, FIRE_RANDOM);
+    } else if (enemyWaveCount % 15 == 0) {
+        spawnFormation(FORMATION_ARROW, SCREEN_WIDTH / 2, 0, FIRE_RANDOM);
+    } else {
+        int xPos = rand() % (SCREEN_WIDTH - ENEMY_WIDTH);
+        spawnFormation(FORMATION_SINGLE, xPos, 0, FIRE_RANDOM);
+    }
+}
+
+void closeWaveTimeline(WaveTimeline& timeline) {
+#ifdef _WIN32
+    if (timeline.mapping) UnmapViewOfFile(timeline.mapping);
+    if (timeline.fileMapping) CloseHandle(timeline.fileMapping);
+    if (timeline.file != INVALID_HANDLE_VALUE) CloseHandle(timeline.file);
+#else
+    if (timeline.mapping) munmap(timeline.mapping, timeline.mappingSize);
+#endif
+    timeline = WaveTimeline();
+}
+
+// Maps a compiled timeline. Only the header is checked, so load cost doesn't
+// depend on how long the level is; pages are faulted in as the cursor reaches
+// them.
+bool openWaveTimeline(WaveTimeline& timeline, const char* path) {
+    closeWaveTimeline(timeline);
+
+#ifdef _WIN32
+    timeline.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (timeline.file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(timeline.file, &size) || size.QuadPart < LONGLONG(sizeof(WaveFileHeader))) {
+        closeWaveTimeline(timeline);
+        return false;
+    }
+    timeline.mappingSize = size_t(size.QuadPart);
+    timeline.fileMapping = CreateFileMappingA(timeline.file, NULL, PAGE_READONLY, 0, 0, NULL);
+    timeline.mapping = timeline.fileMapping ? MapViewOfFile(timeline.fileMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < off_t(sizeof(WaveFileHeader))) {
+        close(fd);
+        return false;
+    }
+    timeline.mappingSize = size_t(info.st_size);
+    timeline.mapping = mmap(NULL, timeline.mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (timeline.mapping == MAP_FAILED) timeline.mapping = NULL;
+    if (timeline.mapping) madvise(timeline.mapping, timeline.mappingSize, MADV_SEQUENTIAL);
+#endif
+    if (!timeline.mapping) {
+        closeWaveTimeline(timeline);
+        return false;
+    }
+
+    const WaveFileHeader* header = static_cast<const WaveFileHeader*>(timeline.mapping);
+    size_t available = (timeline.mappingSize - sizeof(WaveFileHeader)) / sizeof(WaveRecord);
+    if (header->magic != WAVE_FILE_MAGIC || header->version != WAVE_FILE_VERSION || header->recordCount > available) {
+        cout << "Invalid wave timeline: " << path << endl;
+        closeWaveTimeline(timeline);
+        return false;
+    }
+
+    timeline.records = reinterpret_cast<const WaveRecord*>(header + 1);
+    timeline.count = header->recordCount;
+    return true;
+}
+
+void rewindWaveTimeline(WaveTimeline& timeline) {
+    timeline.cursor = 0;
+    timeline.tick = 0;
+}
+
+bool waveTimelineFinished(const WaveTimeline& timeline) {
+    return timeline.cursor >= timeline.count;
+}
+
+// Spawns everything scheduled up to the current tick and advances one tick.
+void advanceWaveTimeline(WaveTimeline& timeline) {
+    while (timeline.cursor < timeline.count && timeline.records[timeline.cursor].tick <= timeline.tick) {
+        const WaveRecord& record = timeline.records[timeline.cursor++];
+        spawnFormation(record.formation, record.x, record.y, record.firePattern);
+    }
+    timeline.tick++;
+}
+
+int lookupName(const char* const* names, int count, const string& name) {
+    for (int i = 0; i < count; i++) {
+        if (name == names[i]) return i;
+    }
+    return -1;
+}
+
+// Text format, one spawn per line, '#' starts a comment:
+//   <tick> <single|line|arrow> <x> <y> <basic> <random|none>
+bool compileWaveTimeline(const char* textPath, const char* binaryPath) {
+    static const char* const formationNames[FORMATION_COUNT] = { "single", "line", "arrow" };
+    static const char* const enemyTypeNames[ENEMY_TYPE_COUNT] = { "basic" };
+    static const char* const firePatternNames[FIRE_PATTERN_COUNT] = { "random", "none" };
+
+    ifstream in(textPath);
+    if (!in) {
+        cout << "Failed to open " << textPath << endl;
+        return false;
+    }
+
+    vector<WaveRecord> records;
+    string line;
+    int lineNumber = 0;
+    while (getline(in, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == string::npos) continue;
+
+        istringstream fields(line);
+        long long tick;
+        int x, y;
+        string formation, enemyType, firePattern;
+        if (!(fields >> tick >> formation >> x >> y >> enemyType >> firePattern)) {
+            cout << textPath << ":" << lineNumber << ": expected <tick> <formation> <x> <y> <type> <fire>" << endl;
+            return false;
+        }
+
+        WaveRecord record = {};
+        int formationId = lookupName(formationNames, FORMATION_COUNT, formation);
+        int typeId = lookupName(enemyTypeNames, ENEMY_TYPE_COUNT, enemyType);
+        int fireId = lookupName(firePatternNames, FIRE_PATTERN_COUNT, firePattern);
+        if (tick < 0 || tick > 0xFFFFFFFFLL || formationId < 0 || typeId < 0 || fireId < 0 ||
+            x < -32768 || x > 32767 || y < -32768 || y > 32767) {
+            cout << textPath << ":" << lineNumber << ": invalid value" << endl;
+            return false;
+        }
+        record.tick = Uint32(tick);
+        record.formation = Uint16(formationId);
+        record.enemyType = Uint16(typeId);
+        record.x = Sint16(x);
+        record.y = Sint16(y);
+        record.firePattern = Uint16(fireId);
+        records.push_back(record);
+    }
+
+    stable_sort(records.begin(), records.end(),
+        [](const WaveRecord& a, const WaveRecord& b) { return a.tick < b.tick; });
+
+    ofstream out(binaryPath, ios::binary);
+    WaveFileHeader header = { WAVE_FILE_MAGIC, WAVE_FILE_VERSION, Uint32(records.size()), 0 };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!records.empty()) {
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(WaveRecord));
+    }
+    if (!out) {
+        cout << "Failed to write " << binaryPath << endl;
+        return false;
+    }
+    cout << "Wrote " << records.size() << " spawns to " << binaryPath << endl;
+    return true;
+}
+
+void collideBulletsWithEnemies() {
+    for (auto& bullet : bullets) {
+        if (bullet.active) {
+            SDL_Rect bRect = { bullet.x, bullet.y, bullet.w, bullet.h };
+            for (auto& enemy : enemies) {
+                SDL_Rect eRect = { enemy.x, enemy.y, enemy.w, enemy.h };
+                if (enemy.active && spritesCollide(bRect, bulletMask, eRect, enemyMask)) {
+                    enemy.active = false;
+                    bullet.active = false;
+                    publishEvent(GAME_EVENT_ENEMY_KILLED, enemy.x + enemy.w / 2, enemy.y + enemy.h / 2, 10);
+                }
+            }
+        }
+    }
+}
+
+void initHomingProjectiles(HomingProjectiles& hp) {
+    hp.count = 0;
+    for (vector<float>* field : { &hp.x, &hp.y, &hp.dirX, &hp.dirY, &hp.speed, &hp.maxSpeed,
+                                  &hp.accel, &hp.cosTurn, &hp.sinTurn, &hp.life }) {
+        field->assign(MAX_HOMING_PROJECTILES, 0.0f);
+    }
+}
+
+void launchHoming(HomingProjectiles& hp, float x, float y, float angle, float speed,
+                  float maxSpeed, float accel, float turnRate, int life) {
+    if (hp.count == MAX_HOMING_PROJECTILES) return;
+    int i = hp.count++;
+    hp.x[i] = x;
+    hp.y[i] = y;
+    hp.dirX[i] = cos(angle);
+    hp.dirY[i] = sin(angle);
+    hp.speed[i] = speed;
+    hp.maxSpeed[i] = maxSpeed;
+    hp.accel[i] = accel;
+    hp.cosTurn[i] = cos(turnRate);
+    hp.sinTurn[i] = sin(turnRate);
+    hp.life[i] = float(life);
+}
+
+void removeHoming(HomingProjectiles& hp, int i) {
+    int last = --hp.count;
+    hp.x[i] = hp.x[last];
+    hp.y[i] = hp.y[last];
+    hp.dirX[i] = hp.dirX[last];
+    hp.dirY[i] = hp.dirY[last];
+    hp.speed[i] = hp.speed[last];
+    hp.maxSpeed[i] = hp.maxSpeed[last];
+    hp.accel[i] = hp.accel[last];
+    hp.cosTurn[i] = hp.cosTurn[last];
+    hp.sinTurn[i] = hp.sinTurn[last];
+    hp.life[i] = hp.life[last];
+}
+
+// Turns every heading towards (targetX, targetY), snapping onto it once it is
+// within one turn step, then integrates speed and position. No trig per
+// projectile: the turn is a rotation by the stored cos/sin with the side
+// picked from the sign of the cross product.
+void steerHoming(HomingProjectiles& hp, float targetX, float targetY) {
+    float* __restrict x = hp.x.data();
+    float* __restrict y = hp.y.data();
+    float* __restrict dirX = hp.dirX.data();
+    float* __restrict dirY = hp.dirY.data();
+    float* __restrict speed = hp.speed.data();
+    const float* __restrict maxSpeed = hp.maxSpeed.data();
+    const float* __restrict accel = hp.accel.data();
+    const float* __restrict cosTurn = hp.cosTurn.data();
+    const float* __restrict sinTurn = hp.sinTurn.data();
+    float* __restrict life = hp.life.data();
+    int i = 0;
+
+#ifdef __SSE2__
+    const __m128 tx = _mm_set1_ps(targetX);
+    const __m128 ty = _mm_set1_ps(targetY);
+    const __m128 epsilon = _mm_set1_ps(1e-6f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 three = _mm_set1_ps(3.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= hp.count; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 dx = _mm_sub_ps(tx, px);
+        __m128 dy = _mm_sub_ps(ty, py);
+        __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), epsilon);
+        __m128 inv = _mm_rsqrt_ps(lengthSq);
+        inv = _mm_mul_ps(_mm_mul_ps(half, inv), _mm_sub_ps(three, _mm_mul_ps(lengthSq, _mm_mul_ps(inv, inv))));
+        dx = _mm_mul_ps(dx, inv);
+        dy = _mm_mul_ps(dy, inv);
+
+        __m128 cx = _mm_loadu_ps(dirX + i);
+        __m128 cy = _mm_loadu_ps(dirY + i);
+        __m128 c = _mm_loadu_ps(cosTurn + i);
+        __m128 sn = _mm_loadu_ps(sinTurn + i);
+        __m128 dot = _mm_add_ps(_mm_mul_ps(cx, dx), _mm_mul_ps(cy, dy));
+        __m128 cross = _mm_sub_ps(_mm_mul_ps(cx, dy), _mm_mul_ps(cy, dx));
+        sn = _mm_xor_ps(sn, _mm_and_ps(cross, signBit));
+        __m128 rx = _mm_sub_ps(_mm_mul_ps(cx, c), _mm_mul_ps(cy, sn));
+        __m128 ry = _mm_add_ps(_mm_mul_ps(cx, sn), _mm_mul_ps(cy, c));
+        __m128 snap = _mm_cmpge_ps(dot, c);
+        __m128 nx = _mm_or_ps(_mm_and_ps(snap, dx), _mm_andnot_ps(snap, rx));
+        __m128 ny = _mm_or_ps(_mm_and_ps(snap, dy), _mm_andnot_ps(snap, ry));
+
+        __m128 v = _mm_min_ps(_mm_add_ps(_mm_loadu_ps(speed + i), _mm_loadu_ps(accel + i)), _mm_loadu_ps(maxSpeed + i));
+        _mm_storeu_ps(dirX + i, nx);
+        _mm_storeu_ps(dirY + i, ny);
+        _mm_storeu_ps(speed + i, v);
+        _mm_storeu_ps(x + i, _mm_add_ps(px, _mm_mul_ps(nx, v)));
+        _mm_storeu_ps(y + i, _mm_add_ps(py, _mm_mul_ps(ny, v)));
+        _mm_storeu_ps(life + i, _mm_sub_ps(_mm_loadu_ps(life + i), one));
+    }
+#endif
+
+    for (; i < hp.count; i++) {
+        float dx = targetX - x[i];
+        float dy = targetY - y[i];
+        float inv = 1.0f / sqrt(dx * dx + dy * dy + 1e-6f);
+        dx *= inv;
+        dy *= inv;
+
+        float cx = dirX[i], cy = dirY[i];
+        float c = cosTurn[i];
+        float sn = (cx * dy - cy * dx < 0) ? -sinTurn[i] : sinTurn[i];
+        if (cx * dx + cy * dy >= c) {
+            dirX[i] = dx;
+            dirY[i] = dy;
+        } else {
+            dirX[i] = cx * c - cy * sn;
+            dirY[i] = cx * sn + cy * c;
+        }
+
+        speed[i] = min(speed[i] + accel[i], maxSpeed[i]);
+        x[i] += dirX[i] * speed[i];
+        y[i] += dirY[i] * speed[i];
+        life[i] -= 1.0f;
+    }
+}
+
+void resetTimerWheel(TimerWheel& wheel) {
+    wheel.now = 0;
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        wheel.slots[i] = -1;
+    }
+    for (int i = 0; i < MAX_TIMER_EVENTS; i++) {
+        wheel.events[i].next = (i + 1 < MAX_TIMER_EVENTS) ? i + 1 : -1;
+    }
+    wheel.freeList = 0;
+}
+
+// Delays below one tick are rounded up so a handler can't re-enter the slot
+// being processed.
+void scheduleEvent(TimerWheel& wheel, Uint32 delay, BossEventType type, int data) {
+    if (wheel.freeList == -1) {
+        cout << "Timer wheel full, dropping event " << type << endl;
+        return;
+    }
+    int index = wheel.freeList;
+    TimerEvent& event = wheel.events[index];
+    wheel.freeList = event.next;
+
+    event.due = wheel.now + max(delay, Uint32(1));
+    event.type = type;
+    event.data = data;
+    int& slot = wheel.slots[event.due % TIMER_WHEEL_SLOTS];
+    event.next = slot;
+    slot = index;
+}
+
+// Frames until a skill that is off cooldown gets cast when it would otherwise
+// get a SKILL_CAST_CHANCE roll every frame (geometric distribution).
+Uint32 skillCastDelay() {
+    float u = (rand() % 10000 + 1) / 10000.0f;
+    return Uint32(log(u) / log(1.0f - SKILL_CAST_CHANCE));
+}
+
+// Casts a skill and returns its cooldown in frames at the current phase.
+int castBossSkill(Boss& boss, int skill) {
+    int cooldownMultiplier = (boss.phase == 1) ? 2 : 1;
+    TimerWheel& wheel = boss.scheduler;
+
+    if (skill == SKILL_LASER) {
+        for (int i = 0; i < 3; i++) {
+            Laser laser;
+            laser.x = (SCREEN_WIDTH / 4) * (i + 1) - 80;
+            laser.y = BOSS_HEIGHT + 100;
+            laser.width = LASER_WIDTH;
+            laser.height = LASER_HEIGHT;
+            laser.active = true;
+            laser.expireTick = wheel.now + LASER_DURATION;
+            boss.lasers.push_back(laser);
+        }
+        scheduleEvent(wheel, LASER_DURATION, EVENT_LASER_END, 0);
+        return 900 / cooldownMultiplier;
+    }
+
+    if (skill == SKILL_MISSILE) {
+        float launchX = boss.x + BOSS_WIDTH / 2;
+        float launchY = boss.y + BOSS_HEIGHT + MISSILE_HEIGHT / 2;
+        if (boss.phase == 1) {
+            for (int i = 0; i < MISSILE_SWARM_SIZE; i++) {
+                float angle = 0.3f + 2.5f * i / (MISSILE_SWARM_SIZE - 1);
+                launchHoming(boss.missiles, launchX, launchY, angle, 2.0f, 6.0f, 0.1f, 0.04f, MISSILE_DURATION);
+            }
+        } else {
+            launchHoming(boss.missiles, launchX, launchY, 1.5708f, 5.0f, 5.0f, 0.0f, 0.05f, MISSILE_DURATION);
+        }
+        return 500 / cooldownMultiplier;
+    }
+
+    if (skill == SKILL_SHIELD) {
+        boss.state = BOSS_SHIELDED;
+        boss.shieldEndTick = wheel.now + SHIELD_DURATION;
+        scheduleEvent(wheel, SHIELD_DURATION, EVENT_SHIELD_END, 0);
+        return 700 / cooldownMultiplier;
+    }
+
+    if (skill == SKILL_SPIRAL) {
+        int bullets = 12 + rand() % 5;
+        for (int i = 0; i < bullets; i++) {
+            GameObject bullet;
+            bullet.x = boss.x + BOSS_WIDTH / 2;
+            bullet.y = boss.y + BOSS_HEIGHT;
+            bullet.w = SPIRAL_BULLET_SIZE;
+            bullet.h = SPIRAL_BULLET_SIZE;
+            bullet.active = true;
+            boss.spiralBullets.push_back(bullet);
+        }
+        return 800 / cooldownMultiplier;
+    }
+
+    int minionCount = 2 + rand() % 4;
+    for (int i = 0; i < minionCount; i++) {
+        GameObject minion;
+        minion.x = rand() % (SCREEN_WIDTH - ENEMY_WIDTH);
+        minion.y = -ENEMY_HEIGHT;
+        minion.w = ENEMY_WIDTH;
+        minion.h = ENEMY_HEIGHT;
+        minion.active = true;
+        boss.minions.push_back(minion);
+    }
+    return 300 / cooldownMultiplier;
+}
+
+void handleBossEvent(Boss& boss, const TimerEvent& event) {
+    TimerWheel& wheel = boss.scheduler;
+    switch (event.type) {
+    case EVENT_CAST_SKILL:
+        if (boss.health > 0) {
+            int cooldown = castBossSkill(boss, event.data);
+            scheduleEvent(wheel, cooldown + skillCastDelay(), EVENT_CAST_SKILL, event.data);
+        }
+        break;
+    case EVENT_SHIELD_END:
+        if (boss.state == BOSS_SHIELDED && wheel.now >= boss.shieldEndTick) {
+            boss.state = BOSS_NORMAL;
+        }
+        break;
+    case EVENT_LASER_END:
+        for (auto& laser : boss.lasers) {
+            if (laser.expireTick <= wheel.now) laser.active = false;
+        }
+        break;
+    case EVENT_PHASE_CHANGE:
+        boss.phase = event.data;
+        break;
+    }
+}
+
+// Advances the boss clock one frame and runs whatever is due.
+void runBossEvents(Boss& boss) {
+    TimerWheel& wheel = boss.scheduler;
+    wheel.now++;
+
+    int* link = &wheel.slots[wheel.now % TIMER_WHEEL_SLOTS];
+    while (*link != -1) {
+        int index = *link;
+        TimerEvent event = wheel.events[index];
+        if (event.due != wheel.now) {
+            link = &wheel.events[index].next;
+            continue;
+        }
+        *link = event.next;
+        wheel.events[index].next = wheel.freeList;
+        wheel.freeList = index;
+        handleBossEvent(boss, event);
+    }
+}
+
+void damageBoss(Boss& boss, int amount) {
+    int before = boss.health;
+    boss.health -= amount;
+    int threshold = BOSS_INITIAL_HEALTH * 4 / 10;
+    if (before > threshold && boss.health <= threshold) {
+        scheduleEvent(boss.scheduler, 1, EVENT_PHASE_CHANGE, 1);
     }
 }
 
@@ -153,17 +1480,50 @@ void initBoss(Boss& boss) {
     boss.initialX = boss.x;
     boss.health = BOSS_INITIAL_HEALTH;
     boss.state = BOSS_NORMAL;
-    boss.shieldTimer = 0;
+    boss.shieldEndTick = 0;
     boss.phase = 0;
     boss.attackPattern = 0;
     boss.laserTimer = 0;
 
+    resetTimerWheel(boss.scheduler);
     for (int i = 0; i < SKILL_COUNT; i++) {
-        boss.skillCooldowns[i] = 0;
+        scheduleEvent(boss.scheduler, skillCastDelay(), EVENT_CAST_SKILL, i);
+    }
+
+    boss.lasers.reserve(ENTITY_RESERVE);
+    if (boss.missiles.x.empty()) initHomingProjectiles(boss.missiles);
+    boss.missiles.count = 0;
+    boss.spiralBullets.reserve(ENTITY_RESERVE);
+    boss.minions.reserve(ENTITY_RESERVE);
+}
+
+void updateSpiralBullets(Boss& boss, Player& player) {
+    for (auto& bullet : boss.spiralBullets) {
+        if (bullet.active) {
+            float angle = atan2(bullet.y - (boss.y + BOSS_HEIGHT), bullet.x - (boss.x + BOSS_WIDTH / 2));
+            angle += 0.1;
+            float distance = sqrt(pow(bullet.x - (boss.x + BOSS_WIDTH / 2), 2) +
+                                 pow(bullet.y - (boss.y + BOSS_HEIGHT), 2));
+            distance += 2;
+
+            bullet.x = boss.x + BOSS_WIDTH / 2 + distance * cos(angle);
+            bullet.y = boss.y + BOSS_HEIGHT + distance * sin(angle);
+
+            SDL_Rect bRect = { bullet.x, bullet.y, bullet.w, bullet.h };
+            SDL_Rect pRect = { player.x, player.y, PLAYER_WIDTH, PLAYER_HEIGHT };
+            if (spritesCollide(bRect, spiralBulletMask, pRect, playerMask)) {
+                bullet.active = false;
+                if (!player.invincible) hitPlayer(player);
+            }
+
+            if (bullet.x < 0 || bullet.x > SCREEN_WIDTH || bullet.y < 0 || bullet.y > SCREEN_HEIGHT) {
+                bullet.active = false;
+            }
+        }
     }
 }
 
-void updateBoss(Boss& boss, Player& player, vector<Explosion>& explosions, int& enemyShootCounter) {
+void updateBoss(Boss& boss, Player& player, int& enemyShootCounter) {
     boss.x += boss.speedX * boss.moveDirection;
 
     if (boss.x > boss.initialX + boss.moveRange) {
@@ -178,84 +1538,7 @@ void updateBoss(Boss& boss, Player& player, vector<Explosion>& explosions, int&
     boss.x = max(0, min(boss.x, SCREEN_WIDTH - BOSS_WIDTH));
     boss.y = max(50, min(boss.y, SCREEN_HEIGHT / 3));
 
-    if (boss.state == BOSS_SHIELDED) {
-        boss.shieldTimer--;
-        if (boss.shieldTimer <= 0) {
-            boss.state = BOSS_NORMAL;
-        }
-    }
-
-    for (int i = 0; i < SKILL_COUNT; i++) {
-        if (boss.skillCooldowns[i] > 0) {
-            boss.skillCooldowns[i]--;
-        }
-    }
-
-    boss.phase = (boss.health <= BOSS_INITIAL_HEALTH * 0.4) ? 1 : 0;
-
-    if (boss.health > 0) {
-        int skillChance = rand() % 100;
-        int cooldownMultiplier = (boss.phase == 1) ? 2 : 1;
-
-        if (boss.skillCooldowns[SKILL_LASER] == 0 && skillChance < 20) {
-            for (int i = 0; i < 3; i++) {
-                Laser laser;
-                laser.x = (SCREEN_WIDTH / 4) * (i + 1) - 80;
-                laser.y = BOSS_HEIGHT + 100;
-                laser.width = 160;
-                laser.height = SCREEN_HEIGHT - (BOSS_HEIGHT + 100);
-                laser.active = true;
-                laser.timer = LASER_DURATION;
-                boss.lasers.push_back(laser);
-            }
-            boss.skillCooldowns[SKILL_LASER] = 900 / cooldownMultiplier;
-        }
-
-        if (boss.skillCooldowns[SKILL_MISSILE] == 0 && skillChance >= 20 && skillChance < 40) {
-            GameObject missile;
-            missile.x = boss.x + BOSS_WIDTH / 2 - 15;
-            missile.y = boss.y + BOSS_HEIGHT;
-            missile.w = 30;
-            missile.h = 50;
-            missile.active = true;
-            boss.missiles.push_back(missile);
-            boss.skillCooldowns[SKILL_MISSILE] = 500 / cooldownMultiplier;
-        }
-
-        if (boss.skillCooldowns[SKILL_SHIELD] == 0 && skillChance >= 40 && skillChance < 60) {
-            boss.state = BOSS_SHIELDED;
-            boss.shieldTimer = SHIELD_DURATION;
-            boss.skillCooldowns[SKILL_SHIELD] = 700 / cooldownMultiplier;
-        }
-
-        if (boss.skillCooldowns[SKILL_SPIRAL] == 0 && skillChance >= 60 && skillChance < 80) {
-            int bullets = 12 + rand() % 5;
-            for (int i = 0; i < bullets; i++) {
-                GameObject bullet;
-                bullet.x = boss.x + BOSS_WIDTH / 2;
-                bullet.y = boss.y + BOSS_HEIGHT;
-                bullet.w = 20;
-                bullet.h = 20;
-                bullet.active = true;
-                boss.spiralBullets.push_back(bullet);
-            }
-            boss.skillCooldowns[SKILL_SPIRAL] = 800 / cooldownMultiplier;
-        }
-
-        if (boss.skillCooldowns[SKILL_MINIONS] == 0 && skillChance >= 80) {
-            int minionCount = 2 + rand() % 4;
-            for (int i = 0; i < minionCount; i++) {
-                GameObject minion;
-                minion.x = rand() % (SCREEN_WIDTH - ENEMY_WIDTH);
-                minion.y = -ENEMY_HEIGHT;
-                minion.w = ENEMY_WIDTH;
-                minion.h = ENEMY_HEIGHT;
-                minion.active = true;
-                boss.minions.push_back(minion);
-            }
-            boss.skillCooldowns[SKILL_MINIONS] = 300 / cooldownMultiplier;
-        }
-    }
+    runBossEvents(boss);
 
     for (auto& minion : boss.minions) {
         if (minion.active) {
@@ -267,14 +1550,9 @@ void updateBoss(Boss& boss, Player& player, vector<Explosion>& explosions, int&
 
             SDL_Rect mRect = { minion.x, minion.y, minion.w, minion.h };
             SDL_Rect pRect = { player.x, player.y, PLAYER_WIDTH, PLAYER_HEIGHT };
-            if (SDL_HasIntersection(&mRect, &pRect)) {
+            if (spritesCollide(mRect, enemyMask, pRect, playerMask)) {
                 minion.active = false;
-                if (!player.invincible) {
-                    player.lives--;
-                    player.invincible = true;
-                    player.invincibleTimer = 90;
-                    Mix_PlayChannel(-1, soundHit, 0);
-                }
+                if (!player.invincible) hitPlayer(player);
             }
 
             if (minion.y > SCREEN_HEIGHT) {
@@ -285,186 +1563,653 @@ void updateBoss(Boss& boss, Player& player, vector<Explosion>& explosions, int&
 
     for (auto& laser : boss.lasers) {
         if (laser.active) {
-            laser.timer--;
-            if (laser.timer <= 0) {
-                laser.active = false;
-            }
-
             SDL_Rect lRect = { laser.x, laser.y, laser.width, laser.height };
             SDL_Rect pRect = { player.x, player.y, PLAYER_WIDTH, PLAYER_HEIGHT };
-            if (SDL_HasIntersection(&lRect, &pRect)) {
-                if (!player.invincible) {
-                    player.lives--;
-                    player.invincible = true;
-                    player.invincibleTimer = 90;
-                    Mix_PlayChannel(-1, soundHit, 0);
-                }
+            if (spritesCollide(lRect, laserMask, pRect, playerMask)) {
+                if (!player.invincible) hitPlayer(player);
             }
         }
     }
 
-    for (auto& missile : boss.missiles) {
-        if (missile.active) {
-            if (missile.x < player.x + PLAYER_WIDTH / 2) missile.x += 3;
-            else if (missile.x > player.x + PLAYER_WIDTH / 2) missile.x -= 3;
-            missile.y += 5;
+    steerHoming(boss.missiles, player.x + PLAYER_WIDTH / 2, player.y + PLAYER_HEIGHT / 2);
 
-            SDL_Rect mRect = { missile.x, missile.y, missile.w, missile.h };
-            SDL_Rect pRect = { player.x, player.y, PLAYER_WIDTH, PLAYER_HEIGHT };
-            if (SDL_HasIntersection(&mRect, &pRect)) {
-                missile.active = false;
-                if (!player.invincible) {
-                    player.lives--;
-                    player.invincible = true;
-                    player.invincibleTimer = 90;
-                    Mix_PlayChannel(-1, soundHit, 0);
-                }
-            }
+    SDL_Rect pRect = { player.x, player.y, PLAYER_WIDTH, PLAYER_HEIGHT };
+    for (int i = 0; i < boss.missiles.count; ) {
+        SDL_Rect mRect = { int(boss.missiles.x[i]) - MISSILE_WIDTH / 2, int(boss.missiles.y[i]) - MISSILE_HEIGHT / 2,
+                           MISSILE_WIDTH, MISSILE_HEIGHT };
+        bool hit = spritesCollide(mRect, bossMissileMask, pRect, playerMask);
+        if (hit && !player.invincible) {
+            hitPlayer(player);
+        }
 
-            if (missile.y > SCREEN_HEIGHT) {
-                missile.active = false;
-            }
+        if (hit || boss.missiles.life[i] <= 0 || mRect.y > SCREEN_HEIGHT) {
+            removeHoming(boss.missiles, i);
+        } else {
+            i++;
         }
     }
 
-    for (auto& bullet : boss.spiralBullets) {
-        if (bullet.active) {
-            float angle = atan2(bullet.y - (boss.y + BOSS_HEIGHT), bullet.x - (boss.x + BOSS_WIDTH / 2));
-            angle += 0.1;
-            float distance = sqrt(pow(bullet.x - (boss.x + BOSS_WIDTH / 2), 2) +
-                                 pow(bullet.y - (boss.y + BOSS_HEIGHT), 2));
-            distance += 2;
+    updateSpiralBullets(boss, player);
 
-            bullet.x = boss.x + BOSS_WIDTH / 2 + distance * cos(angle);
-            bullet.y = boss.y + BOSS_HEIGHT + distance * sin(angle);
+    boss.lasers.erase(remove_if(boss.lasers.begin(), boss.lasers.end(),
+        [](const Laser& l) { return !l.active; }), boss.lasers.end());
+    boss.spiralBullets.erase(remove_if(boss.spiralBullets.begin(), boss.spiralBullets.end(),
+        [](const GameObject& b) { return !b.active; }), boss.spiralBullets.end());
+    boss.minions.erase(remove_if(boss.minions.begin(), boss.minions.end(),
+        [](const GameObject& m) { return !m.active; }), boss.minions.end());
+}
 
-            SDL_Rect bRect = { bullet.x, bullet.y, bullet.w, bullet.h };
-            SDL_Rect pRect = { player.x, player.y, PLAYER_WIDTH, PLAYER_HEIGHT };
-            if (SDL_HasIntersection(&bRect, &pRect)) {
-                bullet.active = false;
-                if (!player.invincible) {
-                    player.lives--;
-                    player.invincible = true;
-                    player.invincibleTimer = 90;
-                    Mix_PlayChannel(-1, soundHit, 0);
+void initRenderQueue(RenderQueue& queue) {
+    queue.commands.reserve(RENDER_BATCH_QUADS);
+    initQuadMesh(queue.vertices, queue.indices, RENDER_BATCH_QUADS);
+}
+
+// Queues a sprite for the next flush; anything entirely outside the screen
+// is dropped here.
+void submitDraw(RenderQueue& queue, int layer, SDL_Texture* texture, const SDL_Rect& rect) {
+    static const SDL_Rect viewport = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+    if (!texture || !SDL_HasIntersection(&rect, &viewport)) return;
+    queue.commands.push_back({ layer, texture, rect, Uint32(queue.commands.size()) });
+}
+
+// Sorts by layer then texture and draws each run of one texture with a single
+// SDL_RenderGeometry call.
+void flushRenderQueue(SDL_Renderer* renderer, RenderQueue& queue) {
+    vector<RenderCommand>& commands = queue.commands;
+    sort(commands.begin(), commands.end(), [](const RenderCommand& a, const RenderCommand& b) {
+        if (a.layer != b.layer) return a.layer < b.layer;
+        if (a.texture != b.texture) return a.texture < b.texture;
+        return a.order < b.order;
+    });
+
+    size_t i = 0;
+    while (i < commands.size()) {
+        SDL_Texture* texture = commands[i].texture;
+        int quads = 0;
+        while (i < commands.size() && commands[i].texture == texture && quads < RENDER_BATCH_QUADS) {
+            const SDL_Rect& r = commands[i].rect;
+            SDL_Vertex* v = &queue.vertices[quads * 4];
+            v[0].position = { float(r.x), float(r.y) };
+            v[1].position = { float(r.x + r.w), float(r.y) };
+            v[2].position = { float(r.x + r.w), float(r.y + r.h) };
+            v[3].position = { float(r.x), float(r.y + r.h) };
+            quads++;
+            i++;
+        }
+        SDL_RenderGeometry(renderer, texture, queue.vertices.data(), quads * 4, queue.indices.data(), quads * 6);
+    }
+    commands.clear();
+}
+
+void initTextureManager(TextureManager& manager, SDL_Renderer* renderer) {
+    manager.renderer = renderer;
+    SDL_RendererInfo info;
+    manager.softwareRenderer = SDL_GetRendererInfo(renderer, &info) == 0 && (info.flags & SDL_RENDERER_SOFTWARE);
+
+    size_t budgetMb = DEFAULT_TEXTURE_BUDGET_MB;
+    const char* budgetEnv = SDL_getenv("GAME1_TEXTURE_BUDGET_MB");
+    if (budgetEnv && atoi(budgetEnv) > 0) budgetMb = size_t(atoi(budgetEnv));
+    manager.budgetBytes = budgetMb * 1024 * 1024;
+}
+
+void unloadTexture(TextureManager& manager, int id) {
+    TextureEntry& entry = manager.entries[id];
+    if (!entry.texture) return;
+    SDL_DestroyTexture(entry.texture);
+    (manager.softwareRenderer ? manager.cpuBytes : manager.gpuBytes) -= entry.bytes;
+    entry.texture = NULL;
+    entry.bytes = 0;
+}
+
+void enforceTextureBudget(TextureManager& manager) {
+    while (manager.gpuBytes + manager.cpuBytes > manager.budgetBytes) {
+        int victim = -1;
+        for (int i = 0; i < TEXTURE_COUNT; i++) {
+            const TextureEntry& entry = manager.entries[i];
+            if (!entry.texture || entry.lastUsedFrame >= manager.frame) continue;
+            if (victim == -1 || entry.lastUsedFrame < manager.entries[victim].lastUsedFrame) victim = i;
+        }
+        if (victim == -1) return;
+        unloadTexture(manager, victim);
+        manager.evictions++;
+    }
+}
+
+// Box-filters an RGBA32 surface to w x h, weighting colour by alpha so
+// transparent pixels don't darken the edges.
+SDL_Surface* scaleSurfaceArea(SDL_Surface* src, int w, int h) {
+    SDL_Surface* dst = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
+    if (!dst) return NULL;
+
+    SDL_LockSurface(src);
+    const Uint8* srcPixels = static_cast<const Uint8*>(src->pixels);
+    Uint8* dstPixels = static_cast<Uint8*>(dst->pixels);
+    for (int y = 0; y < h; y++) {
+        int y0 = y * src->h / h;
+        int y1 = max(y0 + 1, (y + 1) * src->h / h);
+        for (int x = 0; x < w; x++) {
+            int x0 = x * src->w / w;
+            int x1 = max(x0 + 1, (x + 1) * src->w / w);
+            Uint32 r = 0, g = 0, b = 0, a = 0;
+            for (int sy = y0; sy < y1; sy++) {
+                const Uint8* p = srcPixels + sy * src->pitch + x0 * 4;
+                for (int sx = x0; sx < x1; sx++, p += 4) {
+                    r += p[0] * p[3];
+                    g += p[1] * p[3];
+                    b += p[2] * p[3];
+                    a += p[3];
                 }
             }
+            Uint8* out = dstPixels + y * dst->pitch + x * 4;
+            int samples = (x1 - x0) * (y1 - y0);
+            out[0] = a ? Uint8(r / a) : 0;
+            out[1] = a ? Uint8(g / a) : 0;
+            out[2] = a ? Uint8(b / a) : 0;
+            out[3] = Uint8(a / samples);
+        }
+    }
+    SDL_UnlockSurface(src);
+    return dst;
+}
 
-            if (bullet.x < 0 || bullet.x > SCREEN_WIDTH || bullet.y < 0 || bullet.y > SCREEN_HEIGHT) {
-                bullet.active = false;
+// FNV-1a over the source file, so editing a sprite invalidates its variants.
+Uint64 hashBytes(const vector<char>& bytes) {
+    Uint64 hash = 14695981039346656037ULL;
+    for (char c : bytes) {
+        hash = (hash ^ Uint8(c)) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Returns the asset scaled to its draw size, from SPRITE_CACHE_DIR when a
+// variant for this source and size already exists, otherwise scaling it
+// now and writing the variant back for the next run.
+SDL_Surface* loadPrescaledSurface(TextureManager& manager, const TextureAsset& asset) {
+    ifstream in(asset.path, ios::binary);
+    vector<char> bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    if (bytes.empty()) return NULL;
+
+    char cachePath[256];
+    snprintf(cachePath, sizeof(cachePath), "%s/%016llx_%dx%d.bmp", SPRITE_CACHE_DIR,
+             (unsigned long long)hashBytes(bytes), asset.width, asset.height);
+
+    SDL_Surface* cached = SDL_LoadBMP(cachePath);
+    if (cached && cached->w == asset.width && cached->h == asset.height) {
+        manager.cacheHits++;
+        return cached;
+    }
+    SDL_FreeSurface(cached);
+
+    SDL_Surface* loaded = IMG_Load_RW(SDL_RWFromConstMem(bytes.data(), int(bytes.size())), 1);
+    SDL_Surface* source = loaded ? SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0) : NULL;
+    SDL_FreeSurface(loaded);
+    if (!source) return NULL;
+
+    SDL_Surface* scaled = scaleSurfaceArea(source, asset.width, asset.height);
+    SDL_FreeSurface(source);
+    if (!scaled) return NULL;
+    manager.prescaled++;
+
+#ifdef _WIN32
+    CreateDirectoryA(SPRITE_CACHE_DIR, NULL);
+#else
+    mkdir(SPRITE_CACHE_DIR, 0755);
+#endif
+    if (SDL_SaveBMP(scaled, cachePath) != 0) {
+        cout << "Failed to cache " << cachePath << ": " << SDL_GetError() << endl;
+    }
+    return scaled;
+}
+
+// Masks come from the same pre-scaled surface as the texture, so collision
+// edges match the drawn pixels exactly. They are built on the first load
+// only and kept when the texture is evicted.
+SDL_Texture* loadAssetTexture(TextureManager& manager, int id) {
+    const TextureAsset& asset = TEXTURE_ASSETS[id];
+    if (asset.width == 0) return IMG_LoadTexture(manager.renderer, asset.path);
+
+    SDL_Surface* surface = loadPrescaledSurface(manager, asset);
+    CollisionMask* mask = TEXTURE_MASKS[id];
+    if (mask && mask->bits.empty()) *mask = buildCollisionMask(surface, asset.width, asset.height);
+    if (!surface) return NULL;
+    SDL_Texture* texture = manager.renderer ? SDL_CreateTextureFromSurface(manager.renderer, surface) : NULL;
+    SDL_FreeSurface(surface);
+    return texture;
+}
+
+// Builds every mask up front, for tools that collide without a renderer.
+void loadCollisionMasks(TextureManager& manager) {
+    for (int i = 0; i < TEXTURE_COUNT; i++) {
+        CollisionMask* mask = TEXTURE_MASKS[i];
+        if (!mask || !mask->bits.empty()) continue;
+        const TextureAsset& asset = TEXTURE_ASSETS[i];
+        SDL_Surface* surface = loadPrescaledSurface(manager, asset);
+        *mask = buildCollisionMask(surface, asset.width, asset.height);
+        SDL_FreeSurface(surface);
+    }
+}
+
+SDL_Texture* getTexture(TextureManager& manager, int id) {
+    TextureEntry& entry = manager.entries[id];
+    entry.lastUsedFrame = manager.frame;
+    if (entry.texture || entry.failed) return entry.texture;
+
+    manager.misses++;
+    entry.texture = loadAssetTexture(manager, id);
+    if (!entry.texture) {
+        cout << "Failed to load " << TEXTURE_ASSETS[id].path << ": " << IMG_GetError() << endl;
+        entry.failed = true;
+        return NULL;
+    }
+
+    Uint32 format;
+    int w, h;
+    SDL_QueryTexture(entry.texture, &format, NULL, &w, &h);
+    int bytesPerPixel = SDL_BYTESPERPIXEL(format);
+    entry.bytes = size_t(w) * h * (bytesPerPixel ? bytesPerPixel : 4);
+    (manager.softwareRenderer ? manager.cpuBytes : manager.gpuBytes) += entry.bytes;
+    SDL_SetTextureBlendMode(entry.texture, TEXTURE_ASSETS[id].blendMode);
+    manager.loads++;
+
+    enforceTextureBudget(manager);
+    return entry.texture;
+}
+
+// Loads everything a mode draws up front so entering it doesn't hitch later.
+void preloadTextures(TextureManager& manager, int mode) {
+    for (int i = 0; i < TEXTURE_COUNT; i++) {
+        if (TEXTURE_ASSETS[i].modes & mode) getTexture(manager, i);
+    }
+}
+
+void beginTextureFrame(TextureManager& manager) {
+    manager.frame++;
+}
+
+void reportTextureResidency(const TextureManager& manager) {
+    int resident = 0;
+    for (int i = 0; i < TEXTURE_COUNT; i++) {
+        if (manager.entries[i].texture) resident++;
+    }
+    printf("Textures: %d/%d resident, %.1f MB GPU, %.1f MB CPU, budget %.1f MB, %d loads, %d misses, %d evictions, "
+           "%d prescaled, %d from cache\n",
+           resident, TEXTURE_COUNT, manager.gpuBytes / 1048576.0, manager.cpuBytes / 1048576.0,
+           manager.budgetBytes / 1048576.0, manager.loads, manager.misses, manager.evictions,
+           manager.prescaled, manager.cacheHits);
+}
+
+void destroyTextureManager(TextureManager& manager) {
+    for (int i = 0; i < TEXTURE_COUNT; i++) {
+        unloadTexture(manager, i);
+    }
+}
+
+bool initResolutionScaler(SDL_Renderer* renderer, ResolutionScaler& scaler) {
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1");
+    scaler.target = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+    if (!scaler.target) {
+        cout << "Dynamic resolution disabled: " << SDL_GetError() << endl;
+        return false;
+    }
+    return true;
+}
+
+// At full scale the frame goes straight to the window; the target and the
+// stretch back up are only paid for once the scale has actually dropped.
+void beginScaledRender(SDL_Renderer* renderer, ResolutionScaler& scaler) {
+    scaler.active = scaler.target && scaler.scale < 1.0f;
+    if (!scaler.active) return;
+    SDL_SetRenderTarget(renderer, scaler.target);
+    SDL_RenderSetScale(renderer, scaler.scale, scaler.scale);
+    SDL_RenderClear(renderer);
+}
+
+// Stretches the rendered corner of the target over the whole window; HUD
+// drawn after this is at full resolution.
+void endScaledRender(SDL_Renderer* renderer, ResolutionScaler& scaler) {
+    if (!scaler.active) return;
+    scaler.active = false;
+    SDL_SetRenderTarget(renderer, NULL);
+    SDL_Rect source = { 0, 0, int(SCREEN_WIDTH * scaler.scale), int(SCREEN_HEIGHT * scaler.scale) };
+    SDL_RenderCopy(renderer, scaler.target, &source, NULL);
+}
+
+// Call after the present of a gameplay frame. A few consecutive frames over
+// budget lower the scale a step; a long run with headroom raises it.
+void updateResolutionScale(ResolutionScaler& scaler) {
+    if (!scaler.target) return;
+
+    double frameMs = (SDL_GetPerformanceCounter() - scaler.frameStart) * 1000.0 / SDL_GetPerformanceFrequency();
+    scaler.overBudgetFrames = (frameMs > FRAME_BUDGET_MS) ? scaler.overBudgetFrames + 1 : 0;
+    scaler.headroomFrames = (frameMs < FRAME_BUDGET_MS * 0.7) ? scaler.headroomFrames + 1 : 0;
+
+    float scale = scaler.scale;
+    if (scaler.overBudgetFrames >= SCALE_DOWN_FRAMES) {
+        scale = max(MIN_RENDER_SCALE, scale - RENDER_SCALE_STEP);
+    } else if (scaler.headroomFrames >= SCALE_UP_FRAMES) {
+        scale = scale + RENDER_SCALE_STEP;
+        if (scale > 1.0f - RENDER_SCALE_STEP / 2) scale = 1.0f;
+    }
+
+    if (scale != scaler.scale) {
+        scaler.scale = scale;
+        scaler.overBudgetFrames = 0;
+        scaler.headroomFrames = 0;
+    }
+}
+
+// Full-range BT.601 4:2:0, averaging each 2x2 block for chroma.
+void convertFrameToYuv(const Uint8* argb, int width, int height, Uint8* yuv) {
+    Uint8* yPlane = yuv;
+    Uint8* uPlane = yPlane + width * height;
+    Uint8* vPlane = uPlane + (width / 2) * (height / 2);
+
+    for (int y = 0; y < height; y++) {
+        const Uint32* row = (const Uint32*)(argb + size_t(y) * width * 4);
+        for (int x = 0; x < width; x++) {
+            int r = (row[x] >> 16) & 0xFF, g = (row[x] >> 8) & 0xFF, b = row[x] & 0xFF;
+            yPlane[y * width + x] = Uint8((77 * r + 150 * g + 29 * b) >> 8);
+        }
+    }
+
+    for (int y = 0; y < height / 2; y++) {
+        const Uint32* row0 = (const Uint32*)(argb + size_t(2 * y) * width * 4);
+        const Uint32* row1 = row0 + width;
+        for (int x = 0; x < width / 2; x++) {
+            Uint32 p[4] = { row0[2 * x], row0[2 * x + 1], row1[2 * x], row1[2 * x + 1] };
+            int r = 0, g = 0, b = 0;
+            for (int i = 0; i < 4; i++) {
+                r += (p[i] >> 16) & 0xFF;
+                g += (p[i] >> 8) & 0xFF;
+                b += p[i] & 0xFF;
             }
+            r >>= 2; g >>= 2; b >>= 2;
+            uPlane[y * (width / 2) + x] = Uint8(128 + ((-43 * r - 85 * g + 128 * b) >> 8));
+            vPlane[y * (width / 2) + x] = Uint8(128 + ((128 * r - 107 * g - 21 * b) >> 8));
         }
     }
+}
 
-    boss.lasers.erase(remove_if(boss.lasers.begin(), boss.lasers.end(),
-        [](const Laser& l) { return !l.active; }), boss.lasers.end());
-    boss.missiles.erase(remove_if(boss.missiles.begin(), boss.missiles.end(),
-        [](const GameObject& m) { return !m.active; }), boss.missiles.end());
-    boss.spiralBullets.erase(remove_if(boss.spiralBullets.begin(), boss.spiralBullets.end(),
-        [](const GameObject& b) { return !b.active; }), boss.spiralBullets.end());
-    boss.minions.erase(remove_if(boss.minions.begin(), boss.minions.end(),
-        [](const GameObject& m) { return !m.active; }), boss.minions.end());
+int captureWriterThread(void* data) {
+    CaptureRecorder& rec = *(CaptureRecorder*)data;
+    size_t frameBytes = rec.yuv.size();
+
+    SDL_LockMutex(rec.lock);
+    while (true) {
+        while (rec.readyCount == 0 && !rec.stopping) {
+            SDL_CondWait(rec.wake, rec.lock);
+        }
+        if (rec.readyCount == 0) break;
+
+        int index = rec.readyBuffers[rec.readyHead];
+        rec.readyHead = (rec.readyHead + 1) % CAPTURE_BUFFER_COUNT;
+        rec.readyCount--;
+        SDL_UnlockMutex(rec.lock);
+
+        convertFrameToYuv(rec.buffers[index].data(), rec.width, rec.height, rec.yuv.data());
+        bool ok = fputs("FRAME\n", rec.file) >= 0 && fwrite(rec.yuv.data(), 1, frameBytes, rec.file) == frameBytes;
+
+        SDL_LockMutex(rec.lock);
+        rec.freeBuffers[rec.freeCount++] = index;
+        if (!ok) {
+            rec.writeFailed = true;
+            break;
+        }
+        rec.written++;
+    }
+    SDL_UnlockMutex(rec.lock);
+    return 0;
 }
 
-void renderBoss(SDL_Renderer* renderer, Boss& boss, SDL_Texture* bossTexture,
-                SDL_Texture* bossShieldTexture, SDL_Texture* laserTexture,
-                SDL_Texture* bossMissileTexture, SDL_Texture* enemyTexture) {
-    if (boss.health <= 0) return;
+bool startCapture(CaptureRecorder& rec, SDL_Renderer* renderer, const char* path) {
+    if (rec.writer) return false;
 
-    SDL_Rect bossRect = { boss.x, boss.y, BOSS_WIDTH, BOSS_HEIGHT };
-    if (boss.state == BOSS_SHIELDED) {
-        SDL_RenderCopy(renderer, bossShieldTexture, NULL, &bossRect);
-    } else {
-        SDL_RenderCopy(renderer, bossTexture, NULL, &bossRect);
+    int width, height;
+    if (SDL_GetRendererOutputSize(renderer, &width, &height) != 0) {
+        cout << "Failed to start capture: " << SDL_GetError() << endl;
+        return false;
     }
+    width &= ~1;
+    height &= ~1;
 
-    SDL_Rect healthBarBg = { boss.x, boss.y - 20, BOSS_WIDTH, 10 };
-    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-    SDL_RenderFillRect(renderer, &healthBarBg);
+    rec.file = fopen(path, "wb");
+    if (!rec.file) {
+        cout << "Failed to open " << path << endl;
+        return false;
+    }
+    fprintf(rec.file, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg\n", width, height);
 
-    SDL_Rect healthBar = { boss.x, boss.y - 20, BOSS_WIDTH * boss.health / BOSS_INITIAL_HEALTH, 10 };
-    SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
-    SDL_RenderFillRect(renderer, &healthBar);
+    rec.width = width;
+    rec.height = height;
+    for (int i = 0; i < CAPTURE_BUFFER_COUNT; i++) {
+        rec.buffers[i].resize(size_t(width) * height * 4);
+        rec.freeBuffers[i] = i;
+    }
+    rec.yuv.resize(size_t(width) * height + 2 * size_t(width / 2) * (height / 2));
+    rec.freeCount = CAPTURE_BUFFER_COUNT;
+    rec.readyHead = 0;
+    rec.readyCount = 0;
+    rec.stopping = false;
+    rec.captured = 0;
+    rec.dropped = 0;
+    rec.written = 0;
+    rec.writeFailed = false;
+
+    rec.lock = SDL_CreateMutex();
+    rec.wake = SDL_CreateCond();
+    rec.writer = SDL_CreateThread(captureWriterThread, "capture", &rec);
+    if (!rec.writer) {
+        cout << "Failed to start capture thread: " << SDL_GetError() << endl;
+        SDL_DestroyCond(rec.wake);
+        SDL_DestroyMutex(rec.lock);
+        fclose(rec.file);
+        rec.file = NULL;
+        return false;
+    }
+    printf("Capturing %dx%d to %s\n", width, height, path);
+    return true;
+}
+
+// Flushes whatever is still queued, then reports.
+void stopCapture(CaptureRecorder& rec) {
+    if (!rec.writer) return;
+
+    SDL_LockMutex(rec.lock);
+    rec.stopping = true;
+    SDL_CondSignal(rec.wake);
+    SDL_UnlockMutex(rec.lock);
+    SDL_WaitThread(rec.writer, NULL);
+    SDL_DestroyCond(rec.wake);
+    SDL_DestroyMutex(rec.lock);
+    if (fclose(rec.file) != 0) rec.writeFailed = true;
+    rec.writer = NULL;
+    rec.file = NULL;
+
+    if (rec.writeFailed) cout << "Capture stopped: failed to write frame data, file is truncated" << endl;
+    printf("Capture: %d frames captured, %d written, %d dropped\n", rec.captured, rec.written, rec.dropped);
+    for (int i = 0; i < CAPTURE_BUFFER_COUNT; i++) {
+        vector<Uint8>().swap(rec.buffers[i]);
+    }
+    vector<Uint8>().swap(rec.yuv);
+}
+
+// Call right before SDL_RenderPresent; the back buffer is undefined after it.
+void captureFrame(CaptureRecorder& rec, SDL_Renderer* renderer) {
+    if (!rec.writer) return;
+
+    SDL_LockMutex(rec.lock);
+    bool failed = rec.writeFailed;
+    int index = (rec.freeCount > 0 && !failed) ? rec.freeBuffers[--rec.freeCount] : -1;
+    SDL_UnlockMutex(rec.lock);
+    if (failed) {
+        stopCapture(rec);
+        return;
+    }
+    if (index == -1) {
+        rec.dropped++;
+        return;
+    }
+
+    SDL_Rect area = { 0, 0, rec.width, rec.height };
+    if (SDL_RenderReadPixels(renderer, &area, SDL_PIXELFORMAT_ARGB8888, rec.buffers[index].data(), rec.width * 4) != 0) {
+        SDL_LockMutex(rec.lock);
+        rec.freeBuffers[rec.freeCount++] = index;
+        SDL_UnlockMutex(rec.lock);
+        rec.dropped++;
+        return;
+    }
+
+    SDL_LockMutex(rec.lock);
+    rec.readyBuffers[(rec.readyHead + rec.readyCount) % CAPTURE_BUFFER_COUNT] = index;
+    rec.readyCount++;
+    SDL_CondSignal(rec.wake);
+    SDL_UnlockMutex(rec.lock);
+    rec.captured++;
+}
+
+// Every present goes through here so captures and latency samples can't be
+// skipped by a new screen.
+void presentFrame(SDL_Renderer* renderer, InputLatencyStats& latency) {
+    captureFrame(capture, renderer);
+    SDL_RenderPresent(renderer);
+    recordPresent(latency);
+}
+
+void renderBoss(RenderQueue& queue, Boss& boss, SDL_Texture* bossTexture,
+                SDL_Texture* bossShieldTexture, SDL_Texture* laserTexture,
+                SDL_Texture* bossMissileTexture, SDL_Texture* spiralBulletTexture, SDL_Texture* enemyTexture) {
+    if (boss.health <= 0) return;
+
+    SDL_Rect bossRect = { boss.x, boss.y, BOSS_WIDTH, BOSS_HEIGHT };
+    submitDraw(queue, LAYER_BOSS, boss.state == BOSS_SHIELDED ? bossShieldTexture : bossTexture, bossRect);
 
     for (const auto& laser : boss.lasers) {
         if (laser.active) {
-            SDL_Rect laserRect = { laser.x, laser.y, laser.width, laser.height };
-            SDL_RenderCopy(renderer, laserTexture, NULL, &laserRect);
+            submitDraw(queue, LAYER_LASERS, laserTexture, { laser.x, laser.y, laser.width, laser.height });
         }
     }
 
-    for (const auto& missile : boss.missiles) {
-        if (missile.active) {
-            SDL_Rect missileRect = { missile.x, missile.y, missile.w, missile.h };
-            SDL_RenderCopy(renderer, bossMissileTexture, NULL, &missileRect);
-        }
+    for (int i = 0; i < boss.missiles.count; i++) {
+        submitDraw(queue, LAYER_BOSS_MISSILES, bossMissileTexture,
+                   { int(boss.missiles.x[i]) - MISSILE_WIDTH / 2, int(boss.missiles.y[i]) - MISSILE_HEIGHT / 2,
+                     MISSILE_WIDTH, MISSILE_HEIGHT });
     }
 
     for (const auto& bullet : boss.spiralBullets) {
         if (bullet.active) {
-            SDL_Rect bulletRect = { bullet.x, bullet.y, bullet.w, bullet.h };
-            SDL_RenderCopy(renderer, bossMissileTexture, NULL, &bulletRect);
+            submitDraw(queue, LAYER_SPIRAL_BULLETS, spiralBulletTexture, { bullet.x, bullet.y, bullet.w, bullet.h });
         }
     }
 
     for (const auto& minion : boss.minions) {
         if (minion.active) {
-            SDL_Rect minionRect = { minion.x, minion.y, minion.w, minion.h };
-            SDL_RenderCopy(renderer, enemyTexture, NULL, &minionRect);
+            submitDraw(queue, LAYER_ENEMIES, enemyTexture, { minion.x, minion.y, minion.w, minion.h });
         }
     }
 }
 
+void renderBossHealthBar(SDL_Renderer* renderer, const Boss& boss) {
+    if (boss.health <= 0) return;
+
+    SDL_Rect healthBarBg = { boss.x, boss.y - 20, BOSS_WIDTH, 10 };
+    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+    SDL_RenderFillRect(renderer, &healthBarBg);
+
+    SDL_Rect healthBar = { boss.x, boss.y - 20, BOSS_WIDTH * boss.health / BOSS_INITIAL_HEALTH, 10 };
+    SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
+    SDL_RenderFillRect(renderer, &healthBar);
+}
+
 void renderScore(SDL_Renderer* renderer, SDL_Texture* lifeTexture, int lives, int score) {
     for (int i = 0; i < lives; i++) {
-        SDL_Rect rect = { 10 + i * 35, 10, 30, 30 };
+        SDL_Rect rect = { 10 + i * 35, 10, LIFE_ICON_SIZE, LIFE_ICON_SIZE };
         SDL_RenderCopy(renderer, lifeTexture, NULL, &rect);
     }
 }
 
-void renderText(SDL_Renderer* renderer, TTF_Font* font, const string& text, int x, int y) {
-    SDL_Color color = { 255, 255, 255 };
-    SDL_Surface* surface = TTF_RenderText_Solid(font, text.c_str(), color);
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-    SDL_Rect dstRect = { x, y, surface->w, surface->h };
-    SDL_FreeSurface(surface);
-    SDL_RenderCopy(renderer, texture, NULL, &dstRect);
-    SDL_DestroyTexture(texture);
+// Every printable ASCII glyph is rendered once, white, so drawing text is
+// only texture copies with a colour mod and never touches the heap.
+void loadGlyphAtlas(SDL_Renderer* renderer, TTF_Font* font, GlyphAtlas& atlas) {
+    SDL_Color white = { 255, 255, 255, 255 };
+    for (int c = 32; c < 127; c++) {
+        SDL_Surface* surface = TTF_RenderGlyph_Solid(font, Uint16(c), white);
+        if (!surface) continue;
+        atlas.glyphs[c] = SDL_CreateTextureFromSurface(renderer, surface);
+        atlas.widths[c] = surface->w;
+        atlas.height = max(atlas.height, surface->h);
+        SDL_FreeSurface(surface);
+    }
+}
+
+void destroyGlyphAtlas(GlyphAtlas& atlas) {
+    for (int c = 0; c < 128; c++) {
+        if (atlas.glyphs[c]) SDL_DestroyTexture(atlas.glyphs[c]);
+        atlas.glyphs[c] = NULL;
+    }
+}
+
+int textWidth(const GlyphAtlas& atlas, const char* text) {
+    int width = 0;
+    for (const char* p = text; *p; p++) {
+        unsigned char c = *p;
+        if (c < 128) width += atlas.widths[c];
+    }
+    return width;
+}
+
+void renderText(SDL_Renderer* renderer, const GlyphAtlas& atlas, const char* text, int x, int y,
+                SDL_Color color = { 255, 255, 255, 255 }) {
+    for (const char* p = text; *p; p++) {
+        unsigned char c = *p;
+        if (c >= 128 || !atlas.glyphs[c]) continue;
+        SDL_Rect dstRect = { x, y, atlas.widths[c], atlas.height };
+        SDL_SetTextureColorMod(atlas.glyphs[c], color.r, color.g, color.b);
+        SDL_RenderCopy(renderer, atlas.glyphs[c], NULL, &dstRect);
+        x += atlas.widths[c];
+    }
 }
 
-void renderMenu(SDL_Renderer* renderer, TTF_Font* font, int selectedOption, int highScore, SDL_Texture* menuBackgroundTexture) {
+void renderMenu(SDL_Renderer* renderer, const GlyphAtlas& atlas, int selectedOption, int highScore, SDL_Texture* menuBackgroundTexture) {
     SDL_RenderCopy(renderer, menuBackgroundTexture, NULL, NULL);
 
-    string options[3] = { "1. Survival", "2. Boss Fight", "3. Exit" };
-    renderText(renderer, font, "High score: " + to_string(highScore), SCREEN_WIDTH/2 - 80, 150);
+    const char* options[3] = { "1. Survival", "2. Boss Fight", "3. Exit" };
+    renderText(renderer, atlas, arenaFormat(frameArena, "High score: %d", highScore), SCREEN_WIDTH/2 - 80, 150);
 
     for (int i = 0; i < 3; ++i) {
-        SDL_Color color = (i == selectedOption) ? SDL_Color{255, 255, 0} : SDL_Color{255, 255, 255};
-        SDL_Surface* surface = TTF_RenderText_Solid(font, options[i].c_str(), color);
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        SDL_Rect rect = { SCREEN_WIDTH/2 - surface->w/2, 250 + i * 100, surface->w, surface->h };
-        SDL_FreeSurface(surface);
-        SDL_RenderCopy(renderer, texture, NULL, &rect);
-        SDL_DestroyTexture(texture);
+        SDL_Color color = (i == selectedOption) ? SDL_Color{255, 255, 0, 255} : SDL_Color{255, 255, 255, 255};
+        renderText(renderer, atlas, options[i], SCREEN_WIDTH/2 - textWidth(atlas, options[i])/2, 250 + i * 100, color);
     }
-
-    SDL_RenderPresent(renderer);
 }
 
 void resetGame(Player& player, vector<GameObject>& bullets,
               vector<GameObject>& enemies, vector<GameObject>& enemyBullets,
-              vector<Explosion>& explosions, int& enemyWaveCount) {
+              ParticleSystem& particles, int& enemyWaveCount) {
     player = { SCREEN_WIDTH / 2 - PLAYER_WIDTH / 2, SCREEN_HEIGHT - PLAYER_HEIGHT - 10 };
     player.lives = 3;
     player.score = 0;
     bullets.clear();
     enemies.clear();
     enemyBullets.clear();
-    explosions.clear();
+    bullets.reserve(ENTITY_RESERVE);
+    enemies.reserve(ENTITY_RESERVE);
+    enemyBullets.reserve(ENTITY_RESERVE);
+    particles.count = 0;
+    resetEventBus(gameEvents);
     enemyWaveCount = 0;
+    rewindWaveTimeline(waveTimeline);
 }
 
-int main() {
+#ifndef GAME1_NO_MAIN
+int main(int argc, char* argv[]) {
+    if (argc == 4 && string(argv[1]) == "--compile-waves") {
+        return compileWaveTimeline(argv[2], argv[3]) ? 0 : 1;
+    }
+
+#ifdef GAME1_TRACK_ALLOCATIONS
+    installAllocationHooks();
+    FrameAllocationTracker allocationTracker;
+#endif
     srand(time(0));
     SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
     IMG_Init(IMG_INIT_PNG);
@@ -486,21 +2231,17 @@ int main() {
         return -1;
     }
 
-    SDL_Texture* playerTexture = IMG_LoadTexture(renderer, "tàu.png");
-    SDL_Texture* bulletTexture = IMG_LoadTexture(renderer, "đạn.png");
-    SDL_Texture* enemyTexture = IMG_LoadTexture(renderer, "địch.png");
-    SDL_Texture* backgroundTexture = IMG_LoadTexture(renderer, "nền.png");
-    SDL_Texture* enemyBulletTexture = IMG_LoadTexture(renderer, "đạn địch.png");
-    SDL_Texture* lifeTexture = IMG_LoadTexture(renderer, "tàu.png");
-    SDL_Texture* explosionTexture = IMG_LoadTexture(renderer, "địch nổ.png");
-    SDL_Texture* startTexture = IMG_LoadTexture(renderer, "fight.png");
-    SDL_Texture* gameOverTexture = IMG_LoadTexture(renderer, "over.png");
-    SDL_Texture* bossTexture = IMG_LoadTexture(renderer, "boss1.png");
-    SDL_Texture* bossShieldTexture = IMG_LoadTexture(renderer, "khiên.png");
-    SDL_Texture* missileTexture = IMG_LoadTexture(renderer, "đạn địch.png");
-    SDL_Texture* bossMissileTexture = IMG_LoadTexture(renderer, "tên lửa boss.png");
-    SDL_Texture* laserTexture = IMG_LoadTexture(renderer, "laze.png");
-    SDL_Texture* menuBackgroundTexture = IMG_LoadTexture(renderer, "menu.png");
+    TextureManager textures;
+    initTextureManager(textures, renderer);
+    preloadTextures(textures, MODE_MENU);
+
+    GlyphAtlas glyphAtlas;
+    loadGlyphAtlas(renderer, font, glyphAtlas);
+    initParticles(particles);
+    initFrameArena(frameArena, FRAME_ARENA_SIZE);
+    initRenderQueue(renderQueue);
+
+    openWaveTimeline(waveTimeline, "survival.wave");
 
     ifstream in("highscore.txt");
     if (in) {
@@ -509,6 +2250,7 @@ int main() {
     }
 
     Player player = { SCREEN_WIDTH / 2 - PLAYER_WIDTH / 2, SCREEN_HEIGHT - PLAYER_HEIGHT - 10 };
+    resetGame(player, bullets, enemies, enemyBullets, particles, enemyWaveCount);
     Boss boss;
     initBoss(boss);
     GameMode gameMode = MENU;
@@ -518,10 +2260,42 @@ int main() {
     int enemySpawnCounter = 0;
     int enemyShootCounter = 0;
     int bulletCooldown = 0;
+    InputLatencyStats inputLatency;
+    FramePacer framePacer;
+    ResolutionScaler resolutionScaler;
+    initResolutionScaler(renderer, resolutionScaler);
 
     while (running) {
+        beginFrame(framePacer);
+        resolutionScaler.frameStart = SDL_GetPerformanceCounter();
+        beginTextureFrame(textures);
+#ifdef GAME1_TRACK_ALLOCATIONS
+        trackFrameAllocations(allocationTracker, gameMode == SURVIVAL || gameMode == BOSS);
+#endif
+        frameArena.used = 0;
+
+        markInputPump(inputLatency);
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) running = false;
+            recordInputEvent(inputLatency, event);
+
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F7) {
+                if (capture.writer) {
+                    stopCapture(capture);
+                } else {
+                    startCapture(capture, renderer, arenaFormat(frameArena, "capture_%u.y4m", SDL_GetTicks()));
+                }
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F8) {
+                reportTextureResidency(textures);
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F9) {
+                reportInputLatency(inputLatency);
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F10) {
+                framePacer.mode = (framePacer.mode == PACING_DELAY_AFTER_PRESENT) ? PACING_SLEEP_BEFORE_INPUT : PACING_DELAY_AFTER_PRESENT;
+                framePacer.nextFrame = 0;
+            }
 
             if (gameMode == MENU) {
                 if (event.type == SDL_KEYDOWN) {
@@ -534,20 +2308,22 @@ int main() {
                     if (event.key.keysym.sym == SDLK_RETURN) {
                         if (selectedOption == 0) {
                             gameMode = SURVIVAL;
+                            preloadTextures(textures, MODE_SURVIVAL);
                             SDL_RenderClear(renderer);
-                            SDL_RenderCopy(renderer, startTexture, NULL, NULL);
-                            SDL_RenderPresent(renderer);
+                            SDL_RenderCopy(renderer, getTexture(textures, TEX_START), NULL, NULL);
+                            presentFrame(renderer, inputLatency);
                             Mix_PlayChannel(-1, soundStart, 0);
                             SDL_Delay(2000);
-                            resetGame(player, bullets, enemies, enemyBullets, explosions, enemyWaveCount);
+                            resetGame(player, bullets, enemies, enemyBullets, particles, enemyWaveCount);
                         } else if (selectedOption == 1) {
                             gameMode = BOSS;
+                            preloadTextures(textures, MODE_BOSS);
                             SDL_RenderClear(renderer);
-                            SDL_RenderCopy(renderer, startTexture, NULL, NULL);
-                            SDL_RenderPresent(renderer);
+                            SDL_RenderCopy(renderer, getTexture(textures, TEX_START), NULL, NULL);
+                            presentFrame(renderer, inputLatency);
                             Mix_PlayChannel(-1, soundStart, 0);
                             SDL_Delay(2000);
-                            resetGame(player, bullets, enemies, enemyBullets, explosions, enemyWaveCount);
+                            resetGame(player, bullets, enemies, enemyBullets, particles, enemyWaveCount);
                             initBoss(boss);
                         } else if (selectedOption == 2) {
                             running = false;
@@ -558,12 +2334,13 @@ int main() {
         }
 
         if (gameMode == MENU) {
-            renderMenu(renderer, font, selectedOption, highScore, menuBackgroundTexture);
-            SDL_Delay(16);
+            renderMenu(renderer, glyphAtlas, selectedOption, highScore, getTexture(textures, TEX_MENU_BACKGROUND));
+            presentFrame(renderer, inputLatency);
+            endFrame(framePacer);
             continue;
         }
 
-        updateExplosions(explosions);
+        updateParticles(particles);
 
         if (gameMode == SURVIVAL) {
             const Uint8* keystate = SDL_GetKeyboardState(NULL);
@@ -576,7 +2353,7 @@ int main() {
             if (keystate[SDL_SCANCODE_SPACE] && bulletCooldown == 0) {
                 bullets.push_back({ player.x + PLAYER_WIDTH / 2 - BULLET_WIDTH / 2, player.y, BULLET_WIDTH, BULLET_HEIGHT, true });
                 bulletCooldown = 10;
-                Mix_PlayChannel(-1, soundShoot, 0);
+                publishEvent(GAME_EVENT_SHOT, player.x + PLAYER_WIDTH / 2, player.y);
             }
 
             if (player.invincible) {
@@ -591,14 +2368,16 @@ int main() {
                 }
             }
 
-            if (++enemySpawnCounter > 60) {
+            if (!waveTimelineFinished(waveTimeline)) {
+                advanceWaveTimeline(waveTimeline);
+            } else if (++enemySpawnCounter > 60) {
                 spawnEnemyWave();
                 enemySpawnCounter = 0;
             }
 
             if (++enemyShootCounter > 30) {
                 for (auto& enemy : enemies) {
-                    if (enemy.active && rand() % 2 == 0) {
+                    if (enemy.active && enemy.firePattern == FIRE_RANDOM && rand() % 2 == 0) {
                         spawnEnemyBullet(enemy);
                     }
                 }
@@ -612,21 +2391,7 @@ int main() {
                 }
             }
 
-            for (auto& bullet : bullets) {
-                if (bullet.active) {
-                    for (auto& enemy : enemies) {
-                        if (enemy.active &&
-                            bullet.x < enemy.x + enemy.w && bullet.x + bullet.w > enemy.x &&
-                            bullet.y < enemy.y + enemy.h && bullet.y + bullet.h > enemy.y) {
-                            explosions.push_back({ enemy.x, enemy.y, 0 });
-                            enemy.active = false;
-                            bullet.active = false;
-                            player.score += 10;
-                            Mix_PlayChannel(-1, soundExplode, 0);
-                        }
-                    }
-                }
-            }
+            collideBulletsWithEnemies();
 
             for (auto& eBullet : enemyBullets) {
                 if (eBullet.active) {
@@ -635,30 +2400,26 @@ int main() {
 
                     SDL_Rect bRect = { eBullet.x, eBullet.y, eBullet.w, eBullet.h };
                     SDL_Rect pRect = { player.x, player.y, PLAYER_WIDTH, PLAYER_HEIGHT };
-                    if (!player.invincible && SDL_HasIntersection(&bRect, &pRect)) {
+                    if (!player.invincible && spritesCollide(bRect, enemyBulletMask, pRect, playerMask)) {
                         eBullet.active = false;
-                        player.lives--;
-                        player.invincible = true;
-                        player.invincibleTimer = 90;
-                        Mix_PlayChannel(-1, soundHit, 0);
+                        hitPlayer(player);
 
                         if (player.lives <= 0) {
-                            if (player.score > highScore) {
-                                highScore = player.score;
-                                ofstream out("highscore.txt");
-                                out << highScore;
-                                out.close();
-                            }
+                            publishEvent(GAME_EVENT_GAME_OVER);
+                            drainScoreEvents(player);
+                            drainAudioEvents();
+                            drainTelemetryEvents();
 
                             SDL_RenderClear(renderer);
-                            SDL_RenderCopy(renderer, gameOverTexture, NULL, NULL);
-                            renderText(renderer, font, "Score: " + to_string(player.score), SCREEN_WIDTH/2 - 100, SCREEN_HEIGHT/2 + 50);
-                            renderText(renderer, font, "Press enter to continue", SCREEN_WIDTH/2 - 150, SCREEN_HEIGHT/2 + 100);
-                            SDL_RenderPresent(renderer);
+                            SDL_RenderCopy(renderer, getTexture(textures, TEX_GAME_OVER), NULL, NULL);
+                            renderText(renderer, glyphAtlas, arenaFormat(frameArena, "Score: %d", player.score), SCREEN_WIDTH/2 - 100, SCREEN_HEIGHT/2 + 50);
+                            renderText(renderer, glyphAtlas, "Press enter to continue", SCREEN_WIDTH/2 - 150, SCREEN_HEIGHT/2 + 100);
+                            presentFrame(renderer, inputLatency);
                             Mix_PlayChannel(-1, soundGameOver, 0);
 
                             bool waiting = true;
                             while (waiting) {
+                                markInputPump(inputLatency);
                                 while (SDL_PollEvent(&event)) {
                                     if (event.type == SDL_QUIT) {
                                         running = false;
@@ -672,7 +2433,8 @@ int main() {
                             }
 
                             gameMode = MENU;
-                            resetGame(player, bullets, enemies, enemyBullets, explosions, enemyWaveCount);
+                            preloadTextures(textures, MODE_MENU);
+                            resetGame(player, bullets, enemies, enemyBullets, particles, enemyWaveCount);
                         }
                     }
                 }
@@ -682,7 +2444,21 @@ int main() {
             enemies.erase(remove_if(enemies.begin(), enemies.end(), [](const GameObject& e) { return !e.active; }), enemies.end());
             enemyBullets.erase(remove_if(enemyBullets.begin(), enemyBullets.end(), [](const GameObject& b) { return !b.active; }), enemyBullets.end());
 
-            SDL_RenderCopy(renderer, backgroundTexture, NULL, NULL);
+            drainScoreEvents(player);
+            drainEffectEvents(particles);
+            drainAudioEvents();
+            drainTelemetryEvents();
+
+            SDL_Texture* backgroundTexture = getTexture(textures, TEX_BACKGROUND);
+            SDL_Texture* playerTexture = getTexture(textures, TEX_PLAYER);
+            SDL_Texture* bulletTexture = getTexture(textures, TEX_BULLET);
+            SDL_Texture* enemyTexture = getTexture(textures, TEX_ENEMY);
+            SDL_Texture* enemyBulletTexture = getTexture(textures, TEX_ENEMY_BULLET);
+            SDL_Texture* explosionTexture = getTexture(textures, TEX_EXPLOSION);
+
+            beginScaledRender(renderer, resolutionScaler);
+            SDL_Rect screenRect = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+            SDL_RenderCopy(renderer, backgroundTexture, NULL, &screenRect);
 
             if (player.invincible && player.invincibleTimer > 80) {
                 SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
@@ -691,39 +2467,36 @@ int main() {
                 SDL_RenderFillRect(renderer, &flashRect);
             }
 
-            SDL_Rect playerRect = { player.x, player.y, PLAYER_WIDTH, PLAYER_HEIGHT };
-            SDL_RenderCopy(renderer, playerTexture, NULL, &playerRect);
+            submitDraw(renderQueue, LAYER_PLAYER, playerTexture, { player.x, player.y, PLAYER_WIDTH, PLAYER_HEIGHT });
 
             for (const auto& bullet : bullets) {
                 if (bullet.active) {
-                    SDL_Rect rect = { bullet.x, bullet.y, BULLET_WIDTH, BULLET_HEIGHT };
-                    SDL_RenderCopy(renderer, bulletTexture, NULL, &rect);
+                    submitDraw(renderQueue, LAYER_PLAYER_BULLETS, bulletTexture, { bullet.x, bullet.y, BULLET_WIDTH, BULLET_HEIGHT });
                 }
             }
 
             for (const auto& enemy : enemies) {
                 if (enemy.active) {
-                    SDL_Rect rect = { enemy.x, enemy.y, ENEMY_WIDTH, ENEMY_HEIGHT };
-                    SDL_RenderCopy(renderer, enemyTexture, NULL, &rect);
+                    submitDraw(renderQueue, LAYER_ENEMIES, enemyTexture, { enemy.x, enemy.y, ENEMY_WIDTH, ENEMY_HEIGHT });
                 }
             }
 
             for (const auto& eBullet : enemyBullets) {
                 if (eBullet.active) {
-                    SDL_Rect rect = { eBullet.x, eBullet.y, eBullet.w, eBullet.h };
-                    SDL_RenderCopy(renderer, enemyBulletTexture, NULL, &rect);
+                    submitDraw(renderQueue, LAYER_ENEMY_BULLETS, enemyBulletTexture, { eBullet.x, eBullet.y, eBullet.w, eBullet.h });
                 }
             }
 
-            for (const auto& explosion : explosions) {
-                SDL_Rect rect = { explosion.x, explosion.y, ENEMY_WIDTH, ENEMY_HEIGHT };
-                SDL_RenderCopy(renderer, explosionTexture, NULL, &rect);
-            }
+            flushRenderQueue(renderer, renderQueue);
 
-            renderScore(renderer, lifeTexture, player.lives, player.score);
-            renderText(renderer, font, "Score: " + to_string(player.score), 950, 10);
-            SDL_RenderPresent(renderer);
-            SDL_Delay(16);
+            renderParticles(renderer, particles, explosionTexture);
+            endScaledRender(renderer, resolutionScaler);
+
+            renderScore(renderer, getTexture(textures, TEX_LIFE_ICON), player.lives, player.score);
+            renderText(renderer, glyphAtlas, arenaFormat(frameArena, "Score: %d", player.score), 950, 10);
+            presentFrame(renderer, inputLatency);
+            updateResolutionScale(resolutionScaler);
+            endFrame(framePacer);
         }
 
         if (gameMode == BOSS) {
@@ -737,7 +2510,7 @@ int main() {
             if (keystate[SDL_SCANCODE_SPACE] && bulletCooldown == 0) {
                 bullets.push_back({ player.x + PLAYER_WIDTH / 2 - BULLET_WIDTH / 2, player.y, BULLET_WIDTH, BULLET_HEIGHT, true });
                 bulletCooldown = 10;
-                Mix_PlayChannel(-1, soundShoot, 0);
+                publishEvent(GAME_EVENT_SHOT, player.x + PLAYER_WIDTH / 2, player.y);
             }
 
             if (player.invincible) {
@@ -745,7 +2518,7 @@ int main() {
                 if (player.invincibleTimer <= 0) player.invincible = false;
             }
 
-            updateBoss(boss, player, explosions, enemyShootCounter);
+            updateBoss(boss, player, enemyShootCounter);
 
             for (auto& bullet : bullets) {
                 if (bullet.active) {
@@ -755,16 +2528,14 @@ int main() {
                     if (boss.health > 0) {
                         SDL_Rect bRect = { bullet.x, bullet.y, bullet.w, bullet.h };
                         SDL_Rect bossRect = { boss.x, boss.y, BOSS_WIDTH, BOSS_HEIGHT };
-                        if (SDL_HasIntersection(&bRect, &bossRect)) {
+                        if (spritesCollide(bRect, bulletMask, bossRect, boss.state == BOSS_SHIELDED ? shieldMask : bossMask)) {
                             bullet.active = false;
                             if (boss.state != BOSS_SHIELDED) {
-                                boss.health -= 10;
+                                damageBoss(boss, 10);
                                 if (boss.health <= 0) {
-                                    explosions.push_back({ boss.x, boss.y, 0 });
-                                    player.score += 500;
-                                    Mix_PlayChannel(-1, soundExplode, 0);
+                                    publishEvent(GAME_EVENT_BOSS_KILLED, boss.x + BOSS_WIDTH / 2, boss.y + BOSS_HEIGHT / 2, 500);
                                 } else {
-                                    Mix_PlayChannel(-1, soundHit, 0);
+                                    publishEvent(GAME_EVENT_BOSS_DAMAGED, bullet.x + bullet.w / 2, bullet.y);
                                 }
                             }
                         }
@@ -774,12 +2545,10 @@ int main() {
                         if (minion.active) {
                             SDL_Rect mRect = { minion.x, minion.y, minion.w, minion.h };
                             SDL_Rect bRect = { bullet.x, bullet.y, bullet.w, bullet.h };
-                            if (SDL_HasIntersection(&bRect, &mRect)) {
+                            if (spritesCollide(bRect, bulletMask, mRect, enemyMask)) {
                                 bullet.active = false;
                                 minion.active = false;
-                                explosions.push_back({ minion.x, minion.y, 0 });
-                                player.score += 10;
-                                Mix_PlayChannel(-1, soundExplode, 0);
+                                publishEvent(GAME_EVENT_ENEMY_KILLED, minion.x + minion.w / 2, minion.y + minion.h / 2, 10);
                             }
                         }
                     }
@@ -793,33 +2562,31 @@ int main() {
 
                     SDL_Rect bRect = { eBullet.x, eBullet.y, eBullet.w, eBullet.h };
                     SDL_Rect pRect = { player.x, player.y, PLAYER_WIDTH, PLAYER_HEIGHT };
-                    if (!player.invincible && SDL_HasIntersection(&bRect, &pRect)) {
+                    if (!player.invincible && spritesCollide(bRect, enemyBulletMask, pRect, playerMask)) {
                         eBullet.active = false;
-                        player.lives--;
-                        player.invincible = true;
-                        player.invincibleTimer = 90;
-                        Mix_PlayChannel(-1, soundHit, 0);
+                        hitPlayer(player);
                     }
                 }
             }
 
+            drainScoreEvents(player);
+
             if (player.lives <= 0) {
-                if (player.score > highScore) {
-                    highScore = player.score;
-                    ofstream out("highscore.txt");
-                    out << highScore;
-                    out.close();
-                }
+                publishEvent(GAME_EVENT_GAME_OVER);
+                drainScoreEvents(player);
+                drainAudioEvents();
+                drainTelemetryEvents();
 
                 SDL_RenderClear(renderer);
-                SDL_RenderCopy(renderer, gameOverTexture, NULL, NULL);
-                renderText(renderer, font, "Score: " + to_string(player.score), SCREEN_WIDTH/2 - 100, SCREEN_HEIGHT/2 + 50);
-                renderText(renderer, font, "Press enter to continue", SCREEN_WIDTH/2 - 150, SCREEN_HEIGHT/2 + 100);
-                SDL_RenderPresent(renderer);
+                SDL_RenderCopy(renderer, getTexture(textures, TEX_GAME_OVER), NULL, NULL);
+                renderText(renderer, glyphAtlas, arenaFormat(frameArena, "Score: %d", player.score), SCREEN_WIDTH/2 - 100, SCREEN_HEIGHT/2 + 50);
+                renderText(renderer, glyphAtlas, "Press enter to continue", SCREEN_WIDTH/2 - 150, SCREEN_HEIGHT/2 + 100);
+                presentFrame(renderer, inputLatency);
                 Mix_PlayChannel(-1, soundGameOver, 0);
 
                 bool waiting = true;
                 while (waiting) {
+                    markInputPump(inputLatency);
                     while (SDL_PollEvent(&event)) {
                         if (event.type == SDL_QUIT) {
                             running = false;
@@ -833,49 +2600,68 @@ int main() {
                 }
 
                 gameMode = MENU;
-                resetGame(player, bullets, enemies, enemyBullets, explosions, enemyWaveCount);
+                preloadTextures(textures, MODE_MENU);
+                resetGame(player, bullets, enemies, enemyBullets, particles, enemyWaveCount);
                 initBoss(boss);
             }
 
-            SDL_RenderCopy(renderer, backgroundTexture, NULL, NULL);
+            drainEffectEvents(particles);
+            drainAudioEvents();
+            drainTelemetryEvents();
+
+            SDL_Texture* backgroundTexture = getTexture(textures, TEX_BACKGROUND);
+            SDL_Texture* playerTexture = getTexture(textures, TEX_PLAYER);
+            SDL_Texture* bulletTexture = getTexture(textures, TEX_BULLET);
+            SDL_Texture* enemyTexture = getTexture(textures, TEX_ENEMY);
+            SDL_Texture* enemyBulletTexture = getTexture(textures, TEX_ENEMY_BULLET);
+            SDL_Texture* explosionTexture = getTexture(textures, TEX_EXPLOSION);
+            SDL_Texture* bossTexture = getTexture(textures, TEX_BOSS);
+            SDL_Texture* bossShieldTexture = getTexture(textures, TEX_BOSS_SHIELD);
+            SDL_Texture* bossMissileTexture = getTexture(textures, TEX_BOSS_MISSILE);
+            SDL_Texture* spiralBulletTexture = getTexture(textures, TEX_SPIRAL_BULLET);
+            SDL_Texture* laserTexture = getTexture(textures, TEX_LASER);
 
-            SDL_Rect playerRect = { player.x, player.y, PLAYER_WIDTH, PLAYER_HEIGHT };
-            SDL_RenderCopy(renderer, playerTexture, NULL, &playerRect);
+            beginScaledRender(renderer, resolutionScaler);
+            SDL_Rect screenRect = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+            SDL_RenderCopy(renderer, backgroundTexture, NULL, &screenRect);
+
+            submitDraw(renderQueue, LAYER_PLAYER, playerTexture, { player.x, player.y, PLAYER_WIDTH, PLAYER_HEIGHT });
 
             for (const auto& bullet : bullets) {
                 if (bullet.active) {
-                    SDL_Rect rect = { bullet.x, bullet.y, BULLET_WIDTH, BULLET_HEIGHT };
-                    SDL_RenderCopy(renderer, bulletTexture, NULL, &rect);
+                    submitDraw(renderQueue, LAYER_PLAYER_BULLETS, bulletTexture, { bullet.x, bullet.y, BULLET_WIDTH, BULLET_HEIGHT });
                 }
             }
 
-            renderBoss(renderer, boss, bossTexture, bossShieldTexture, laserTexture, bossMissileTexture, enemyTexture);
+            renderBoss(renderQueue, boss, bossTexture, bossShieldTexture, laserTexture, bossMissileTexture, spiralBulletTexture, enemyTexture);
 
             for (const auto& eBullet : enemyBullets) {
                 if (eBullet.active) {
-                    SDL_Rect rect = { eBullet.x, eBullet.y, eBullet.w, eBullet.h };
-                    SDL_RenderCopy(renderer, enemyBulletTexture, NULL, &rect);
+                    submitDraw(renderQueue, LAYER_ENEMY_BULLETS, enemyBulletTexture, { eBullet.x, eBullet.y, eBullet.w, eBullet.h });
                 }
             }
 
-            for (const auto& explosion : explosions) {
-                SDL_Rect rect = { explosion.x, explosion.y, ENEMY_WIDTH, ENEMY_HEIGHT };
-                SDL_RenderCopy(renderer, explosionTexture, NULL, &rect);
-            }
+            flushRenderQueue(renderer, renderQueue);
+            renderBossHealthBar(renderer, boss);
 
-            renderScore(renderer, lifeTexture, player.lives, player.score);
-            renderText(renderer, font, "Diem: " + to_string(player.score), 950, 10);
+            renderParticles(renderer, particles, explosionTexture);
+            endScaledRender(renderer, resolutionScaler);
+
+            renderScore(renderer, getTexture(textures, TEX_LIFE_ICON), player.lives, player.score);
+            renderText(renderer, glyphAtlas, arenaFormat(frameArena, "Diem: %d", player.score), 950, 10);
 
             if (boss.health <= 0) {
-                renderText(renderer, font, "VICTORY! Press enter to continue", SCREEN_WIDTH/2 - 150, SCREEN_HEIGHT/2);
+                renderText(renderer, glyphAtlas, "VICTORY! Press enter to continue", SCREEN_WIDTH/2 - 150, SCREEN_HEIGHT/2);
                 if (keystate[SDL_SCANCODE_ESCAPE]) {
                     gameMode = MENU;
+                    preloadTextures(textures, MODE_MENU);
                     initBoss(boss);
                 }
             }
 
-            SDL_RenderPresent(renderer);
-            SDL_Delay(16);
+            presentFrame(renderer, inputLatency);
+            updateResolutionScale(resolutionScaler);
+            endFrame(framePacer);
         }
     }
 
@@ -886,22 +2672,16 @@ int main() {
     Mix_FreeChunk(soundStart);
     Mix_CloseAudio();
 
+    reportInputLatency(inputLatency);
+    reportTextureResidency(textures);
+    reportEventTelemetry(gameEvents);
+    stopCapture(capture);
+    closeWaveTimeline(waveTimeline);
+
+    destroyGlyphAtlas(glyphAtlas);
+    if (resolutionScaler.target) SDL_DestroyTexture(resolutionScaler.target);
     TTF_CloseFont(font);
-    SDL_DestroyTexture(playerTexture);
-    SDL_DestroyTexture(bulletTexture);
-    SDL_DestroyTexture(enemyTexture);
-    SDL_DestroyTexture(enemyBulletTexture);
-    SDL_DestroyTexture(backgroundTexture);
-    SDL_DestroyTexture(lifeTexture);
-    SDL_DestroyTexture(explosionTexture);
-    SDL_DestroyTexture(startTexture);
-    SDL_DestroyTexture(gameOverTexture);
-    SDL_DestroyTexture(bossTexture);
-    SDL_DestroyTexture(bossShieldTexture);
-    SDL_DestroyTexture(missileTexture);
-    SDL_DestroyTexture(bossMissileTexture);
-    SDL_DestroyTexture(laserTexture);
-    SDL_DestroyTexture(menuBackgroundTexture);
+    destroyTextureManager(textures);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     TTF_Quit();
@@ -910,3 +2690,4 @@ int main() {
 
     return 0;
 }
+#endif